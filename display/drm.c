@@ -22,6 +22,9 @@
 #include <errno.h>
 #include <sys/mman.h>
 #include <inttypes.h>
+#include <sys/socket.h>
+#include <sys/sysmacros.h>
+#include <linux/netlink.h>
 
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -67,6 +70,20 @@ struct drm_dev {
 	drmModePropertyPtr conn_props[128];
 	struct drm_buffer drm_bufs[2]; /* DUMB buffers */
 	struct drm_buffer *cur_bufs[2]; /* double buffering handling */
+	uint32_t gamma_blob_id, degamma_blob_id, ctm_blob_id;
+	int color_dirty; /* color blobs changed since the last commit */
+	int modeset; /* next commit has to (re)program the mode */
+	int connected;
+	int uevent_fd; /* kernel uevent socket for connector hotplug */
+	dev_t devnum;
+	int async_flip; /* commit without waiting for vblank, may tear */
+	int legacy; /* no atomic modesetting, use drmModeSetCrtc/drmModePageFlip */
+	int flip_pending; /* a page flip event is outstanding */
+	int frame_started; /* back buffer already holds areas of the current frame */
+	int vrr_capable, vrr_enabled;
+	int vrr_dirty; /* VRR_ENABLED changed since the last commit */
+	uint64_t commit_us; /* time of the commit the next flip event belongs to */
+	drm_flip_info_t flip_info;
 } drm_dev;
 
 static uint32_t get_plane_property_id(const char *name)
@@ -114,10 +131,69 @@ static uint32_t get_conn_property_id(const char *name)
 	return 0;
 }
 
+static int get_object_property_value(uint32_t obj_id, uint32_t obj_type, uint32_t prop_id,
+				     uint64_t *value)
+{
+	drmModeObjectPropertiesPtr props;
+	uint32_t i;
+	int ret = -1;
+
+	if (!prop_id)
+		return -1;
+
+	props = drmModeObjectGetProperties(drm_dev.fd, obj_id, obj_type);
+	if (!props) {
+		err("drmModeObjectGetProperties failed");
+		return -1;
+	}
+
+	for (i = 0; i < props->count_props; i++) {
+		if (props->props[i] == prop_id) {
+			*value = props->prop_values[i];
+			ret = 0;
+			break;
+		}
+	}
+	drmModeFreeObjectProperties(props);
+
+	return ret;
+}
+
+static int get_crtc_property_value(const char *name, uint64_t *value)
+{
+	return get_object_property_value(drm_dev.crtc_id, DRM_MODE_OBJECT_CRTC,
+					 get_crtc_property_id(name), value);
+}
+
+static int get_conn_property_value(const char *name, uint64_t *value)
+{
+	return get_object_property_value(drm_dev.conn_id, DRM_MODE_OBJECT_CONNECTOR,
+					 get_conn_property_id(name), value);
+}
+
+static uint64_t drm_time_us(void)
+{
+	struct timespec ts;
+
+	/* Same clock the kernel uses for the page flip event timestamps */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 static void page_flip_handler(int fd, unsigned int sequence, unsigned int tv_sec,
 			      unsigned int tv_usec, void *user_data)
 {
+	drm_flip_info_t *info = &drm_dev.flip_info;
+
 	dbg("flip");
+
+	info->commit_us = drm_dev.commit_us;
+	info->flip_us = (uint64_t)tv_sec * 1000000 + tv_usec;
+	info->sequence = sequence;
+	info->flip_count++;
+	if (info->flip_us > info->commit_us)
+		info->latency_sum_us += info->flip_us - info->commit_us;
 }
 
 static int drm_get_plane_props(void)
@@ -243,21 +319,50 @@ static int drm_add_conn_property(const char *name, uint64_t value)
 static int drm_dmabuf_set_plane(struct drm_buffer *buf)
 {
 	int ret;
-	static int first = 1;
 	uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT;
+	int async = drm_dev.async_flip && !drm_dev.modeset && !drm_dev.color_dirty &&
+		    !drm_dev.vrr_dirty;
 
 	drm_dev.req = drmModeAtomicAlloc();
 
-	/* On first Atomic commit, do a modeset */
-	if (first) {
+	/* On first Atomic commit and after a mode change, do a modeset */
+	if (drm_dev.modeset) {
 		drm_add_conn_property("CRTC_ID", drm_dev.crtc_id);
 
 		drm_add_crtc_property("MODE_ID", drm_dev.blob_id);
 		drm_add_crtc_property("ACTIVE", 1);
 
 		flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+	}
 
-		first = 0;
+	/* Apply pending color management state */
+	if (drm_dev.color_dirty) {
+		if (get_crtc_property_id("DEGAMMA_LUT"))
+			drm_add_crtc_property("DEGAMMA_LUT", drm_dev.degamma_blob_id);
+		if (get_crtc_property_id("CTM"))
+			drm_add_crtc_property("CTM", drm_dev.ctm_blob_id);
+		if (get_crtc_property_id("GAMMA_LUT"))
+			drm_add_crtc_property("GAMMA_LUT", drm_dev.gamma_blob_id);
+	}
+
+	if (drm_dev.vrr_dirty)
+		drm_add_crtc_property("VRR_ENABLED", drm_dev.vrr_enabled);
+
+	/* Async flips may only change the framebuffer */
+	if (async) {
+		drm_add_plane_property("FB_ID", buf->fb_handle);
+
+		ret = drmModeAtomicCommit(drm_dev.fd, drm_dev.req, flags | DRM_MODE_PAGE_FLIP_ASYNC, NULL);
+		if (!ret) {
+			drm_dev.commit_us = drm_time_us();
+			drm_dev.flip_pending = 1;
+			return 0;
+		}
+
+		err("async flip rejected, falling back to vsync: %s", strerror(errno));
+		drm_dev.async_flip = 0;
+		drmModeAtomicFree(drm_dev.req);
+		drm_dev.req = drmModeAtomicAlloc();
 	}
 
 	drm_add_plane_property("FB_ID", buf->fb_handle);
@@ -275,9 +380,85 @@ static int drm_dmabuf_set_plane(struct drm_buffer *buf)
 	if (ret) {
 		err("drmModeAtomicCommit failed: %s", strerror(errno));
 		drmModeAtomicFree(drm_dev.req);
+		drm_dev.req = NULL;
 		return ret;
 	}
 
+	/* Pending state is only consumed once the commit succeeded, else it is retried */
+	drm_dev.modeset = 0;
+	drm_dev.color_dirty = 0;
+	drm_dev.vrr_dirty = 0;
+
+	drm_dev.commit_us = drm_time_us();
+	drm_dev.flip_pending = 1;
+
+	return 0;
+}
+
+static int drm_legacy_set_crtc_property(const char *name, uint64_t value)
+{
+	uint32_t prop_id = get_crtc_property_id(name);
+
+	if (prop_id && drmModeObjectSetProperty(drm_dev.fd, drm_dev.crtc_id, DRM_MODE_OBJECT_CRTC,
+						prop_id, value)) {
+		err("Setting crtc prop %s failed: %s", name, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int drm_legacy_set_fb(struct drm_buffer *buf)
+{
+	uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT;
+	int ret;
+
+	/* Keep the state pending, to be retried on the next frame, until it is applied */
+	if (drm_dev.color_dirty) {
+		ret = drm_legacy_set_crtc_property("DEGAMMA_LUT", drm_dev.degamma_blob_id);
+		ret |= drm_legacy_set_crtc_property("CTM", drm_dev.ctm_blob_id);
+		ret |= drm_legacy_set_crtc_property("GAMMA_LUT", drm_dev.gamma_blob_id);
+		if (!ret)
+			drm_dev.color_dirty = 0;
+	}
+
+	if (drm_dev.vrr_dirty && !drm_legacy_set_crtc_property("VRR_ENABLED", drm_dev.vrr_enabled))
+		drm_dev.vrr_dirty = 0;
+
+	/* drmModeSetCrtc is synchronous and doesn't send a flip event */
+	if (drm_dev.modeset) {
+		ret = drmModeSetCrtc(drm_dev.fd, drm_dev.crtc_id, buf->fb_handle, 0, 0,
+				     &drm_dev.conn_id, 1, &drm_dev.mode);
+		if (ret) {
+			err("drmModeSetCrtc failed: %s", strerror(errno));
+			return ret;
+		}
+
+		drm_dev.modeset = 0;
+		drm_dev.commit_us = drm_time_us();
+
+		return 0;
+	}
+
+	if (drm_dev.async_flip)
+		flags |= DRM_MODE_PAGE_FLIP_ASYNC;
+
+	ret = drmModePageFlip(drm_dev.fd, drm_dev.crtc_id, buf->fb_handle, flags, NULL);
+	if (ret && drm_dev.async_flip) {
+		err("async flip rejected, falling back to vsync: %s", strerror(errno));
+		drm_dev.async_flip = 0;
+		ret = drmModePageFlip(drm_dev.fd, drm_dev.crtc_id, buf->fb_handle,
+				      DRM_MODE_PAGE_FLIP_EVENT, NULL);
+	}
+
+	if (ret) {
+		err("drmModePageFlip failed: %s", strerror(errno));
+		return ret;
+	}
+
+	drm_dev.commit_us = drm_time_us();
+	drm_dev.flip_pending = 1;
+
 	return 0;
 }
 
@@ -395,7 +576,8 @@ static int drm_find_connector(void)
 
 	memcpy(&drm_dev.mode, &conn->modes[0], sizeof(drmModeModeInfo));
 
-	if (drmModeCreatePropertyBlob(drm_dev.fd, &drm_dev.mode, sizeof(drm_dev.mode),
+	if (!drm_dev.legacy &&
+	    drmModeCreatePropertyBlob(drm_dev.fd, &drm_dev.mode, sizeof(drm_dev.mode),
 				      &drm_dev.blob_id)) {
 		err("error creating mode blob");
 		goto free_res;
@@ -521,6 +703,21 @@ err:
 	return -1;
 }
 
+/* Enable adaptive sync whenever the sink supports it */
+static void drm_probe_vrr(void)
+{
+	uint64_t capable = 0;
+
+	if (get_conn_property_value("vrr_capable", &capable) || !get_crtc_property_id("VRR_ENABLED"))
+		capable = 0;
+
+	drm_dev.vrr_capable = capable;
+	if (drm_dev.vrr_enabled != drm_dev.vrr_capable) {
+		drm_dev.vrr_enabled = drm_dev.vrr_capable;
+		drm_dev.vrr_dirty = 1;
+	}
+}
+
 static int drm_setup(unsigned int fourcc)
 {
 	int ret;
@@ -536,8 +733,8 @@ static int drm_setup(unsigned int fourcc)
 
 	ret = drmSetClientCap(drm_dev.fd, DRM_CLIENT_CAP_ATOMIC, 1);
 	if (ret) {
-		err("No atomic modesetting support: %s", strerror(errno));
-		goto err;
+		info("drm: no atomic modesetting support, using legacy KMS");
+		drm_dev.legacy = 1;
 	}
 
 	ret = drm_find_connector();
@@ -546,16 +743,19 @@ static int drm_setup(unsigned int fourcc)
 		goto err;
 	}
 
-	ret = find_plane(fourcc, &drm_dev.plane_id, drm_dev.crtc_id, drm_dev.crtc_idx);
-	if (ret) {
-		err("Cannot find plane");
-		goto err;
-	}
+	/* Legacy KMS scans out through the CRTC's primary plane implicitly */
+	if (!drm_dev.legacy) {
+		ret = find_plane(fourcc, &drm_dev.plane_id, drm_dev.crtc_id, drm_dev.crtc_idx);
+		if (ret) {
+			err("Cannot find plane");
+			goto err;
+		}
 
-	drm_dev.plane = drmModeGetPlane(drm_dev.fd, drm_dev.plane_id);
-	if (!drm_dev.plane) {
-		err("Cannot get plane");
-		goto err;
+		drm_dev.plane = drmModeGetPlane(drm_dev.fd, drm_dev.plane_id);
+		if (!drm_dev.plane) {
+			err("Cannot get plane");
+			goto err;
+		}
 	}
 
 	drm_dev.crtc = drmModeGetCrtc(drm_dev.fd, drm_dev.crtc_id);
@@ -570,10 +770,12 @@ static int drm_setup(unsigned int fourcc)
 		goto err;
 	}
 
-	ret = drm_get_plane_props();
-	if (ret) {
-		err("Cannot get plane props");
-		goto err;
+	if (!drm_dev.legacy) {
+		ret = drm_get_plane_props();
+		if (ret) {
+			err("Cannot get plane props");
+			goto err;
+		}
 	}
 
 	ret = drm_get_crtc_props();
@@ -591,13 +793,17 @@ static int drm_setup(unsigned int fourcc)
 	drm_dev.drm_event_ctx.version = DRM_EVENT_CONTEXT_VERSION;
 	drm_dev.drm_event_ctx.page_flip_handler = page_flip_handler;
 	drm_dev.fourcc = fourcc;
+	drm_dev.modeset = 1;
+	drm_dev.connected = 1;
+	drm_probe_vrr();
 
 	info("drm: Found plane_id: %u connector_id: %d crtc_id: %d",
 		drm_dev.plane_id, drm_dev.conn_id, drm_dev.crtc_id);
 
-	info("drm: %dx%d (%dmm X% dmm) pixel format %c%c%c%c",
+	info("drm: %dx%d (%dmm X% dmm) pixel format %c%c%c%c%s",
 	     drm_dev.width, drm_dev.height, drm_dev.mmWidth, drm_dev.mmHeight,
-	     (fourcc>>0)&0xff, (fourcc>>8)&0xff, (fourcc>>16)&0xff, (fourcc>>24)&0xff);
+	     (fourcc>>0)&0xff, (fourcc>>8)&0xff, (fourcc>>16)&0xff, (fourcc>>24)&0xff,
+	     drm_dev.vrr_capable ? " VRR" : "");
 
 	return 0;
 
@@ -665,6 +871,25 @@ static int drm_allocate_dumb(struct drm_buffer *buf)
 	return 0;
 }
 
+static void drm_free_dumb(struct drm_buffer *buf)
+{
+	struct drm_mode_destroy_dumb dreq;
+
+	if (buf->fb_handle)
+		drmModeRmFB(drm_dev.fd, buf->fb_handle);
+
+	if (buf->map && buf->map != MAP_FAILED)
+		munmap(buf->map, buf->size);
+
+	if (buf->handle) {
+		memset(&dreq, 0, sizeof(dreq));
+		dreq.handle = buf->handle;
+		drmIoctl(drm_dev.fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+	}
+
+	memset(buf, 0, sizeof(*buf));
+}
+
 static int drm_setup_buffers(void)
 {
 	int ret;
@@ -689,6 +914,10 @@ void drm_wait_vsync(lv_disp_drv_t *disp_drv)
 {
 	int ret;
 	fd_set fds;
+
+	if (!drm_dev.flip_pending)
+		return;
+
 	FD_ZERO(&fds);
 	FD_SET(drm_dev.fd, &fds);
 
@@ -700,6 +929,7 @@ void drm_wait_vsync(lv_disp_drv_t *disp_drv)
 		err("select failed: %s", strerror(errno));
 		drmModeAtomicFree(drm_dev.req);
 		drm_dev.req = NULL;
+		drm_dev.flip_pending = 0;
 		return;
 	}
 
@@ -708,6 +938,7 @@ void drm_wait_vsync(lv_disp_drv_t *disp_drv)
 
 	drmModeAtomicFree(drm_dev.req);
 	drm_dev.req = NULL;
+	drm_dev.flip_pending = 0;
 }
 
 void drm_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p)
@@ -715,13 +946,27 @@ void drm_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color
 	struct drm_buffer *fbuf = drm_dev.cur_bufs[1];
 	lv_coord_t w = (area->x2 - area->x1 + 1);
 	lv_coord_t h = (area->y2 - area->y1 + 1);
-	int i, y;
+	int i, y, ret;
 
 	dbg("x %d:%d y %d:%d w %d h %d", area->x1, area->x2, area->y1, area->y2, w, h);
 
-	/* Partial update */
-	if ((w != drm_dev.width || h != drm_dev.height) && drm_dev.cur_bufs[0])
-		memcpy(fbuf->map, drm_dev.cur_bufs[0]->map, fbuf->size);
+	/* Nothing to scan out to while the sink is unplugged */
+	if (!drm_dev.connected || !fbuf) {
+		lv_disp_flush_ready(disp_drv);
+		return;
+	}
+
+	if (!drm_dev.frame_started) {
+		/* The back buffer is scanned out until the pending flip completes */
+		if (drm_dev.flip_pending)
+			drm_wait_vsync(disp_drv);
+
+		/* Partial update */
+		if ((w != drm_dev.width || h != drm_dev.height) && drm_dev.cur_bufs[0])
+			memcpy(fbuf->map, drm_dev.cur_bufs[0]->map, fbuf->size);
+
+		drm_dev.frame_started = 1;
+	}
 
 	for (y = 0, i = area->y1 ; i <= area->y2 ; ++i, ++y) {
                 memcpy((uint8_t *)fbuf->map + (area->x1 * (LV_COLOR_SIZE/8)) + (fbuf->pitch * i),
@@ -729,12 +974,23 @@ void drm_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color
 		       w * (LV_COLOR_SIZE/8));
 	}
 
-	if (drm_dev.req)
-		drm_wait_vsync(disp_drv);
+	/* Commit once per frame, as soon as its last area is ready */
+	if (!lv_disp_flush_is_last(disp_drv)) {
+		lv_disp_flush_ready(disp_drv);
+		return;
+	}
+
+	drm_dev.frame_started = 0;
 
 	/* show fbuf plane */
-	if (drm_dmabuf_set_plane(fbuf)) {
+	if (drm_dev.legacy)
+		ret = drm_legacy_set_fb(fbuf);
+	else
+		ret = drm_dmabuf_set_plane(fbuf);
+
+	if (ret) {
 		err("Flush fail");
+		lv_disp_flush_ready(disp_drv);
 		return;
 	}
 	else
@@ -770,10 +1026,386 @@ void drm_get_sizes(lv_coord_t *width, lv_coord_t *height, uint32_t *dpi)
 		*dpi = DIV_ROUND_UP(drm_dev.width * 25400, drm_dev.mmWidth * 1000);
 }
 
+static uint32_t drm_get_lut_size(const char *size_prop)
+{
+	uint64_t size;
+
+	if (drm_dev.fd < 0 || get_crtc_property_value(size_prop, &size))
+		return 0;
+
+	return size;
+}
+
+static int drm_replace_blob(uint32_t *blob_id, const void *data, size_t size)
+{
+	uint32_t new_id = 0;
+
+	if (data && drmModeCreatePropertyBlob(drm_dev.fd, data, size, &new_id)) {
+		err("drmModeCreatePropertyBlob failed: %s", strerror(errno));
+		return -1;
+	}
+
+	/* The kernel keeps its own reference while the blob is in use */
+	if (*blob_id)
+		drmModeDestroyPropertyBlob(drm_dev.fd, *blob_id);
+
+	*blob_id = new_id;
+	drm_dev.color_dirty = 1;
+
+	return 0;
+}
+
+static int drm_set_lut(const char *lut_prop, const char *size_prop, uint32_t *blob_id,
+		       const uint16_t *red, const uint16_t *green, const uint16_t *blue,
+		       uint32_t size)
+{
+	struct drm_color_lut *lut;
+	uint32_t i;
+	int ret;
+
+	if (drm_dev.fd < 0 || !get_crtc_property_id(lut_prop)) {
+		err("CRTC has no %s property", lut_prop);
+		return -1;
+	}
+
+	if (!red || !green || !blue)
+		return drm_replace_blob(blob_id, NULL, 0);
+
+	if (size != drm_get_lut_size(size_prop)) {
+		err("%s expects %u entries, got %u", lut_prop, drm_get_lut_size(size_prop), size);
+		return -1;
+	}
+
+	lut = malloc(size * sizeof(*lut));
+	if (!lut) {
+		err("Cannot allocate %s", lut_prop);
+		return -1;
+	}
+
+	for (i = 0; i < size; i++) {
+		lut[i].red = red[i];
+		lut[i].green = green[i];
+		lut[i].blue = blue[i];
+		lut[i].reserved = 0;
+	}
+
+	ret = drm_replace_blob(blob_id, lut, size * sizeof(*lut));
+	free(lut);
+
+	return ret;
+}
+
+uint32_t drm_get_gamma_lut_size(void)
+{
+	return drm_get_lut_size("GAMMA_LUT_SIZE");
+}
+
+uint32_t drm_get_degamma_lut_size(void)
+{
+	return drm_get_lut_size("DEGAMMA_LUT_SIZE");
+}
+
+int drm_set_gamma_lut(const uint16_t *red, const uint16_t *green, const uint16_t *blue, uint32_t size)
+{
+	return drm_set_lut("GAMMA_LUT", "GAMMA_LUT_SIZE", &drm_dev.gamma_blob_id,
+			   red, green, blue, size);
+}
+
+int drm_set_degamma_lut(const uint16_t *red, const uint16_t *green, const uint16_t *blue, uint32_t size)
+{
+	return drm_set_lut("DEGAMMA_LUT", "DEGAMMA_LUT_SIZE", &drm_dev.degamma_blob_id,
+			   red, green, blue, size);
+}
+
+int drm_set_ctm(const double *matrix)
+{
+	struct drm_color_ctm ctm;
+	int i;
+
+	if (drm_dev.fd < 0 || !get_crtc_property_id("CTM")) {
+		err("CRTC has no CTM property");
+		return -1;
+	}
+
+	if (!matrix)
+		return drm_replace_blob(&drm_dev.ctm_blob_id, NULL, 0);
+
+	/* The kernel expects S31.32 sign-magnitude fixed point */
+	for (i = 0; i < 9; i++) {
+		double v = matrix[i];
+		double mag;
+
+		if (v != v) {
+			err("CTM coefficient %d is NaN", i);
+			return -1;
+		}
+
+		/* Saturate so the magnitude never reaches the sign bit */
+		mag = (v < 0 ? -v : v) * (double)(1ULL << 32);
+		if (mag >= (double)(1ULL << 63))
+			ctm.matrix[i] = 0x7FFFFFFFFFFFFFFFULL;
+		else
+			ctm.matrix[i] = (uint64_t)mag;
+
+		if (v < 0)
+			ctm.matrix[i] |= 1ULL << 63;
+	}
+
+	return drm_replace_blob(&drm_dev.ctm_blob_id, &ctm, sizeof(ctm));
+}
+
+static int drm_uevent_open(void)
+{
+	struct sockaddr_nl addr;
+	struct stat st;
+	int fd;
+
+	if (fstat(drm_dev.fd, &st) == 0)
+		drm_dev.devnum = st.st_rdev;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (fd < 0) {
+		err("uevent socket failed: %s", strerror(errno));
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = 1; /* kernel uevents, doesn't need udevd */
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		err("uevent bind failed: %s", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* Check whether a uevent is a hotplug event of our DRM card */
+static int drm_uevent_is_hotplug(const char *msg, ssize_t len)
+{
+	const char *p = msg;
+	const char *end = msg + len;
+	int drm = 0, hotplug = 0;
+	long major = -1, minor = -1;
+
+	while (p < end) {
+		if (!strcmp(p, "SUBSYSTEM=drm"))
+			drm = 1;
+		else if (!strcmp(p, "HOTPLUG=1"))
+			hotplug = 1;
+		else if (!strncmp(p, "MAJOR=", 6))
+			major = strtol(p + 6, NULL, 10);
+		else if (!strncmp(p, "MINOR=", 6))
+			minor = strtol(p + 6, NULL, 10);
+
+		p += strlen(p) + 1;
+	}
+
+	if (!drm || !hotplug)
+		return 0;
+
+	if (major >= 0 && minor >= 0 && drm_dev.devnum &&
+	    makedev(major, minor) != drm_dev.devnum)
+		return 0;
+
+	return 1;
+}
+
+static lv_disp_t *drm_find_disp(lv_disp_drv_t *drv)
+{
+	lv_disp_t *disp = lv_disp_get_next(NULL);
+
+	while (disp && disp->driver != drv)
+		disp = lv_disp_get_next(disp);
+
+	return disp;
+}
+
+/* Re-read the connector and follow its state and preferred mode */
+static int drm_reprobe_connector(lv_disp_drv_t *drv)
+{
+	drmModeConnector *conn;
+	lv_disp_t *disp;
+	int connected, ret;
+
+	conn = drmModeGetConnector(drm_dev.fd, drm_dev.conn_id);
+	if (!conn) {
+		err("drmModeGetConnector failed: %s", strerror(errno));
+		return -1;
+	}
+
+	connected = conn->connection == DRM_MODE_CONNECTED && conn->count_modes > 0;
+
+	if (!connected) {
+		if (drm_dev.connected)
+			info("drm: connector %u disconnected", drm_dev.conn_id);
+		drm_dev.connected = 0;
+		drmModeFreeConnector(conn);
+		return 0;
+	}
+
+	if (drm_dev.connected && !memcmp(&drm_dev.mode, &conn->modes[0], sizeof(drm_dev.mode))) {
+		drmModeFreeConnector(conn);
+		return 0;
+	}
+
+	/* Let a pending flip finish before its buffer goes away */
+	if (drm_dev.flip_pending)
+		drm_wait_vsync(drv);
+
+	memcpy(&drm_dev.mode, &conn->modes[0], sizeof(drmModeModeInfo));
+	drm_dev.mmWidth = conn->mmWidth;
+	drm_dev.mmHeight = conn->mmHeight;
+	drmModeFreeConnector(conn);
+
+	if (drm_dev.blob_id)
+		drmModeDestroyPropertyBlob(drm_dev.fd, drm_dev.blob_id);
+	drm_dev.blob_id = 0;
+
+	if (!drm_dev.legacy &&
+	    drmModeCreatePropertyBlob(drm_dev.fd, &drm_dev.mode, sizeof(drm_dev.mode),
+				      &drm_dev.blob_id)) {
+		err("error creating mode blob");
+		drm_dev.connected = 0;
+		return -1;
+	}
+
+	drm_dev.connected = 1;
+	drm_dev.modeset = 1;
+	drm_dev.frame_started = 0;
+	drm_probe_vrr();
+
+	if (drm_dev.width == drm_dev.mode.hdisplay && drm_dev.height == drm_dev.mode.vdisplay) {
+		info("drm: connector %u reconnected", drm_dev.conn_id);
+
+		/* Updates were dropped while unplugged, redraw everything */
+		disp = drv ? drm_find_disp(drv) : NULL;
+		if (disp) {
+			lv_area_t area;
+
+			lv_area_set(&area, 0, 0, drm_dev.width - 1, drm_dev.height - 1);
+			_lv_inv_area(disp, &area);
+		}
+
+		return 0;
+	}
+
+	drm_dev.width = drm_dev.mode.hdisplay;
+	drm_dev.height = drm_dev.mode.vdisplay;
+
+	info("drm: connector %u changed to %ux%u", drm_dev.conn_id, drm_dev.width, drm_dev.height);
+
+	drm_free_dumb(&drm_dev.drm_bufs[0]);
+	drm_free_dumb(&drm_dev.drm_bufs[1]);
+
+	ret = drm_setup_buffers();
+	if (ret) {
+		err("DRM buffer reallocation failed");
+		drm_dev.cur_bufs[0] = NULL;
+		drm_dev.cur_bufs[1] = NULL;
+		drm_dev.connected = 0;
+		return ret;
+	}
+
+	if (drv) {
+		drv->hor_res = drm_dev.width;
+		drv->ver_res = drm_dev.height;
+
+		disp = drm_find_disp(drv);
+		if (disp)
+			lv_disp_drv_update(disp, drv);
+	}
+
+	return 0;
+}
+
+int drm_set_vrr(bool enable)
+{
+	if (enable && !drm_dev.vrr_capable) {
+		err("connector is not VRR capable");
+		return -1;
+	}
+
+	if (drm_dev.vrr_enabled != enable) {
+		drm_dev.vrr_enabled = enable;
+		drm_dev.vrr_dirty = 1;
+	}
+
+	return 0;
+}
+
+int drm_set_async_flip(bool enable)
+{
+	uint64_t cap = 0;
+
+	if (!enable) {
+		drm_dev.async_flip = 0;
+		return 0;
+	}
+
+	if (drm_dev.legacy) {
+		if (drmGetCap(drm_dev.fd, DRM_CAP_ASYNC_PAGE_FLIP, &cap) < 0)
+			cap = 0;
+	}
+#ifdef DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP
+	else if (drmGetCap(drm_dev.fd, DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP, &cap) < 0) {
+		cap = 0;
+	}
+#endif
+
+	if (!cap) {
+		err("async page flips not supported");
+		return -1;
+	}
+
+	drm_dev.async_flip = 1;
+
+	return 0;
+}
+
+void drm_get_flip_info(drm_flip_info_t *info)
+{
+	*info = drm_dev.flip_info;
+}
+
+int drm_get_hotplug_fd(void)
+{
+	return drm_dev.uevent_fd;
+}
+
+int drm_handle_hotplug(lv_disp_drv_t *drv)
+{
+	char msg[4096];
+	ssize_t len;
+	int hotplug = 0;
+
+	if (drm_dev.fd < 0 || drm_dev.uevent_fd < 0)
+		return 0;
+
+	/* Drain the socket, a replug usually comes as a burst of events */
+	while ((len = recv(drm_dev.uevent_fd, msg, sizeof(msg) - 1, 0)) > 0) {
+		msg[len] = '\0';
+		if (drm_uevent_is_hotplug(msg, len))
+			hotplug = 1;
+	}
+
+	if (!hotplug)
+		return 0;
+
+	if (drm_reprobe_connector(drv))
+		return -1;
+
+	return 1;
+}
+
 void drm_init(void)
 {
 	int ret;
 
+	drm_dev.uevent_fd = -1;
+
 	ret = drm_setup(DRM_FOURCC);
 	if (ret) {
 		close(drm_dev.fd);
@@ -789,11 +1421,19 @@ void drm_init(void)
 		return;
 	}
 
+	drm_dev.uevent_fd = drm_uevent_open();
+	if (drm_dev.uevent_fd < 0)
+		info("drm: connector hotplug detection not available");
+
 	info("DRM subsystem and buffer mapped successfully");
 }
 
 void drm_exit(void)
 {
+	if (drm_dev.uevent_fd >= 0)
+		close(drm_dev.uevent_fd);
+	drm_dev.uevent_fd = -1;
+
 	close(drm_dev.fd);
 	drm_dev.fd = -1;
 }
@@ -36,6 +36,13 @@ extern "C" {
 /**********************
  *      TYPEDEFS
  **********************/
+typedef struct {
+    uint64_t commit_us;         /*CLOCK_MONOTONIC time of the last completed commit [us]*/
+    uint64_t flip_us;           /*Time the kernel reported the flip of that commit [us]*/
+    uint32_t sequence;          /*vblank sequence of the last flip*/
+    uint32_t flip_count;        /*Number of completed flips*/
+    uint64_t latency_sum_us;    /*Sum of commit to flip latencies, divide by `flip_count`*/
+} drm_flip_info_t;
 
 /**********************
  * GLOBAL PROTOTYPES
@@ -46,6 +53,79 @@ void drm_exit(void);
 void drm_flush(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p);
 void drm_wait_vsync(lv_disp_drv_t * drv);
 
+/**
+ * Get the number of entries the CRTC expects in a gamma LUT.
+ * @return LUT size or 0 if the CRTC has no gamma LUT
+ */
+uint32_t drm_get_gamma_lut_size(void);
+
+/**
+ * Get the number of entries the CRTC expects in a degamma LUT.
+ * @return LUT size or 0 if the CRTC has no degamma LUT
+ */
+uint32_t drm_get_degamma_lut_size(void);
+
+/**
+ * Load a gamma LUT into the CRTC. It is applied with the next flush.
+ * @param red, green, blue 16 bit per channel tables, all NULL to disable the LUT
+ * @param size number of entries, must match `drm_get_gamma_lut_size()`
+ * @return 0 on success, -1 on error
+ */
+int drm_set_gamma_lut(const uint16_t * red, const uint16_t * green, const uint16_t * blue, uint32_t size);
+
+/**
+ * Load a degamma LUT into the CRTC. It is applied with the next flush.
+ * @param red, green, blue 16 bit per channel tables, all NULL to disable the LUT
+ * @param size number of entries, must match `drm_get_degamma_lut_size()`
+ * @return 0 on success, -1 on error
+ */
+int drm_set_degamma_lut(const uint16_t * red, const uint16_t * green, const uint16_t * blue, uint32_t size);
+
+/**
+ * Load a color transformation matrix into the CRTC. It is applied with the next flush.
+ * @param matrix 3x3 row-major coefficients (out = matrix * in), NULL to disable the CTM.
+ *               Out-of-range coefficients saturate, NaN is rejected
+ * @return 0 on success, -1 on error
+ */
+int drm_set_ctm(const double * matrix);
+
+/**
+ * Enable or disable adaptive sync (VRR). It is enabled by default if the connector
+ * is VRR capable, so the refresh follows the frame rate LVGL actually renders.
+ * @param enable true to enable VRR, false to use the fixed refresh rate
+ * @return 0 on success, -1 if the connector is not VRR capable
+ */
+int drm_set_vrr(bool enable);
+
+/**
+ * Enable or disable tearing async page flips. New frames are shown immediately
+ * instead of at the next vblank. Requires kernel support for async flips.
+ * @param enable true to enable async flips, false to wait for vblank again
+ * @return 0 on success, -1 if async flips are not supported
+ */
+int drm_set_async_flip(bool enable);
+
+/**
+ * Get the timestamps of the most recent page flip to measure display latency.
+ * @param info store the flip information here
+ */
+void drm_get_flip_info(drm_flip_info_t * info);
+
+/**
+ * Get the file descriptor which becomes readable when a connector hotplug event arrives.
+ * Add it to the application's poll loop and call `drm_handle_hotplug()` when it is readable.
+ * @return a file descriptor or -1 if hotplug detection is not available
+ */
+int drm_get_hotplug_fd(void);
+
+/**
+ * Process pending hotplug events without blocking. If the connector's mode changed
+ * the DRM buffers are reallocated and `drv` is updated to the new resolution.
+ * @param drv pointer to the display driver using `drm_flush`
+ * @return 1 if the connector was re-probed, 0 if nothing changed, -1 on error
+ */
+int drm_handle_hotplug(lv_disp_drv_t * drv);
+
 
 /**********************
  *      MACROS
@@ -115,6 +115,48 @@
 
 /*Open two windows to test multi display support*/
 #  define SDL_DUAL_DISPLAY            0
+
+/*Use a hardware accelerated renderer (falls back to software rendering if not available)*/
+#  define SDL_ACCELERATED             0
+
+/*Synchronize the presentation to the display's refresh*/
+#  define SDL_VSYNC                   0
+
+/*Generate touch events from the mouse to test touch input without touch screen*/
+#  define SDL_MOUSE_TOUCH             0
+
+/*SDL GPU only: copy only the changed areas to the window.
+ *Enable it only if the window's back buffer is kept after presenting (e.g. with the software renderer)*/
+#  define SDL_PARTIAL_PRESENT         0
+
+/*SDL GLES SW mixed mode only: upload through two pixel buffer objects,
+ *so the GPU copies the pixels while the CPU renders the next frame. Needs GLES3 or desktop GL 3, else ignored*/
+#  define SDL_GLES_PBO                0
+
+/*SDL GLES only: rotate the display clockwise by 0, 90, 180 or 270 degrees when presenting*/
+#  define SDL_GLES_ROTATION           0
+
+/*SDL GLES only: scale with linear filtering instead of repeating the pixels for SDL_ZOOM*/
+#  define SDL_GLES_LINEAR_FILTER      0
+
+/*SDL GLES only: render with a surfaceless or pbuffer EGL context instead of a window
+ *(e.g. Mesa llvmpipe on CI machines). The average upload, draw and swap times are printed at exit.*/
+#  define SDL_GLES_HEADLESS           0
+
+/*Show FPS, flush and update time, damaged pixels and uploaded bytes on top of the window.
+ *It's drawn by SDL, so it doesn't affect what LVGL renders. See also `sdl_get_perf()`*/
+#  define SDL_PERF_HUD                0
+
+/*Don't open windows, only render into memory (e.g. on CI machines without display).
+ *Also enabled at runtime if SDL_VIDEODRIVER is "dummy" or "offscreen".
+ *The frame rate and flushed bytes are printed at exit.*/
+#  define SDL_HEADLESS                0
+
+/*In headless mode save every Nth frame as PPM image (0: don't save).
+ *If SDL_DUMP_PATH contains a `%u` it's replaced by the frame number,
+ *else all frames are appended to the same file as a PPM stream*/
+#  define SDL_DUMP_PERIOD             0
+#  define SDL_DUMP_PATH               "frame_%05u.ppm"
 #endif
 
 /*-------------------
@@ -195,6 +237,14 @@
 #  ifndef LV_WAYLAND_XDG_SHELL
 #    define LV_WAYLAND_XDG_SHELL 0
 #  endif
+/* Number of SHM buffers per window (2 or 3), so a buffer held by the compositor is never drawn */
+#  ifndef LV_WAYLAND_BUFFER_COUNT
+#    define LV_WAYLAND_BUFFER_COUNT 2
+#  endif
+/* Let LVGL render directly into two SHM buffers (direct_mode) instead of copying each frame */
+#  ifndef LV_WAYLAND_DIRECT_MODE
+#    define LV_WAYLAND_DIRECT_MODE 0
+#  endif
 #endif
 
 /*----------------
@@ -47,6 +47,35 @@
 # define SDL_FULLSCREEN        0
 #endif
 
+#ifndef SDL_ACCELERATED
+# define SDL_ACCELERATED       0
+#endif
+
+#ifndef SDL_VSYNC
+# define SDL_VSYNC             0
+#endif
+
+#ifndef SDL_MOUSE_TOUCH
+# define SDL_MOUSE_TOUCH       0
+#endif
+
+#ifndef SDL_PERF_HUD
+# define SDL_PERF_HUD          0
+#endif
+
+#ifndef SDL_HEADLESS
+# define SDL_HEADLESS          0
+#endif
+
+#ifndef SDL_DUMP_PERIOD
+# define SDL_DUMP_PERIOD       0
+#endif
+
+#ifndef SDL_DUMP_PATH
+# define SDL_DUMP_PATH         "frame_%05u.ppm"
+#endif
+
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
@@ -55,35 +84,129 @@
 /*********************
  *      DEFINES
  *********************/
-#ifndef KEYBOARD_BUFFER_SIZE
-#define KEYBOARD_BUFFER_SIZE SDL_TEXTINPUTEVENT_TEXT_SIZE
+/*Number of input events buffered per input device, must be a power of 2*/
+#ifndef SDL_INPUT_QUEUE_SIZE
+#define SDL_INPUT_QUEUE_SIZE 64
+#endif
+
+/*Queue slots only presses and releases may use*/
+#define INPUT_QUEUE_STATE_RESERVE (SDL_INPUT_QUEUE_SIZE / 4)
+
+/*Use a texture format matching lv_color_t so the pixels can be copied row by row*/
+#if LV_COLOR_DEPTH == 32 || LV_COLOR_DEPTH == 24
+# define SDL_TEXTURE_FORMAT SDL_PIXELFORMAT_ARGB8888
+#elif LV_COLOR_DEPTH == 16
+# define SDL_TEXTURE_FORMAT SDL_PIXELFORMAT_RGB565
+#elif LV_COLOR_DEPTH == 8
+# define SDL_TEXTURE_FORMAT SDL_PIXELFORMAT_RGB332
+#else
+# define SDL_TEXTURE_FORMAT SDL_PIXELFORMAT_ARGB8888   /*Converted pixel by pixel*/
+#endif
+
+/*Number of fingers tracked per window*/
+#ifndef SDL_TOUCH_POINT_MAX
+#define SDL_TOUCH_POINT_MAX 10
+#endif
+
+/*Number of flushed areas remembered per frame. More areas are merged into their bounding box*/
+#ifndef SDL_DIRTY_AREA_MAX
+#define SDL_DIRTY_AREA_MAX 16
 #endif
 
 /**********************
  *      TYPEDEFS
  **********************/
+/*An input event as it arrived from SDL*/
 typedef struct {
+    uint32_t timestamp;         /*SDL event timestamp [ms]*/
+    lv_point_t point;
+    uint32_t key;
+    int16_t enc_diff;
+    lv_indev_state_t state;
+} input_event_t;
+
+/*Single producer (SDL event watch), single consumer (indev read) lock-free ring buffer*/
+typedef struct {
+    input_event_t events[SDL_INPUT_QUEUE_SIZE];
+    SDL_atomic_t head;          /*Written only by the producer*/
+    SDL_atomic_t tail;          /*Written only by the consumer*/
+} input_queue_t;
+typedef struct _sdl_window_t {
     SDL_Window * window;
     SDL_Renderer * renderer;
     SDL_Texture * texture;
+    Uint32 window_id;
+    lv_coord_t hor_res;
+    lv_coord_t ver_res;
+    int zoom;
+    lv_disp_drv_t * disp_drv;       /*The display flushing to this window*/
+    struct _sdl_window_t * next;
     volatile bool sdl_refr_qry;
+    uint32_t present_period;    /*Minimal time between two presents [ms], 0: paced by vsync*/
+    uint32_t last_present;
 #if SDL_DOUBLE_BUFFERED
-    uint32_t * tft_fb_act;
-#else
-    uint32_t * tft_fb;
+    lv_color_t * tft_fb_act;
+    SDL_Rect dirty[SDL_DIRTY_AREA_MAX];     /*Areas flushed since the last texture update*/
+    uint32_t dirty_cnt;
 #endif
+    input_queue_t mouse_queue;
+    input_event_t mouse_last;       /*Last mouse state passed to LVGL*/
+    input_event_t mouse_in;         /*Mouse state of the last queued event*/
+    input_queue_t touch_queue;      /*Events of the first finger*/
+    input_event_t touch_last;
+    input_event_t touch_in;
+    SDL_FingerID touch_primary;     /*The finger reported by the touch indev*/
+    sdl_touch_point_t touch_points[SDL_TOUCH_POINT_MAX];
+    uint32_t touch_point_cnt;
+    sdl_touch_gesture_t gesture;
+    bool gesture_valid;
+    lv_color_t * headless_fb;       /*Frame buffer of a headless window (no SDL window is opened)*/
+    uint64_t flush_bytes;
+    uint32_t start_time;
+    sdl_perf_t perf;                /*Counters of the last frame*/
+    sdl_perf_t perf_acc;            /*Counters summed since the last frame*/
+    uint32_t perf_fps_frames;
+    uint32_t perf_fps_start;
 }monitor_t;
 
 /**********************
  *  STATIC PROTOTYPES
  **********************/
-static void window_create(monitor_t * m);
+static void sdl_common_init(void);
+static void window_create(monitor_t * m, lv_coord_t hor_res, lv_coord_t ver_res, int zoom);
+static void window_destroy(monitor_t * m);
+static void window_texture_create(monitor_t * m);
+static void window_resize(monitor_t * m, int w, int h);
+static monitor_t * monitor_from_id(Uint32 window_id);
+static monitor_t * monitor_from_disp(lv_disp_t * disp);
+static void window_flush(monitor_t * m, lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p);
 static void window_update(monitor_t * m);
+static uint32_t texture_write(SDL_Texture * texture, const SDL_Rect * r, const lv_color_t * src, int32_t src_stride);
+static uint32_t perf_get_us(void);
+static void perf_frame_end(monitor_t * m);
+#if SDL_PERF_HUD
+static void perf_hud_draw(monitor_t * m);
+#endif
+#if SDL_DOUBLE_BUFFERED
+static void monitor_add_dirty(monitor_t * m, const lv_area_t * area);
+#else
+static void monitor_draw_area(monitor_t * m, const lv_area_t * area, lv_color_t * color_p);
+#endif
 int quit_filter(void * userdata, SDL_Event * event);
 static void monitor_sdl_clean_up(void);
 static void sdl_event_handler(lv_timer_t * t);
 static void monitor_sdl_refr(lv_timer_t * t);
+static bool monitor_present_due(monitor_t * m);
+static void headless_flush(monitor_t * m, lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p);
+static void headless_dump(monitor_t * m);
+static void headless_report(void);
+static int input_event_watch(void * userdata, SDL_Event * event);
+static bool input_queue_push(input_queue_t * q, const input_event_t * e, bool motion);
+static bool input_queue_pop(input_queue_t * q, input_event_t * e);
+static bool input_queue_is_empty(input_queue_t * q);
 static void mouse_handler(SDL_Event * event);
+static void touch_handler(SDL_Event * event);
+static bool touch_to_disp(monitor_t * m, float x, float y, lv_point_t * p);
 static void mousewheel_handler(SDL_Event * event);
 static uint32_t keycode_to_ctrl_key(SDL_Keycode sdl_key);
 static void keyboard_handler(SDL_Event * event);
@@ -99,22 +222,23 @@ static int tick_thread(void *data);
 /**********************
  *  STATIC VARIABLES
  **********************/
-monitor_t monitor;
+static monitor_t monitor;
 
 #if SDL_DUAL_DISPLAY
-monitor_t monitor2;
+static monitor_t monitor2;
 #endif
 
-static volatile bool sdl_quit_qry = false;
+static monitor_t * monitor_list;    /*All windows, linked through `next`*/
+static bool sdl_inited = false;
+static bool sdl_headless = false;
 
-static bool left_button_down = false;
-static int16_t last_x = 0;
-static int16_t last_y = 0;
+static volatile bool sdl_quit_qry = false;
 
-static int16_t wheel_diff = 0;
-static lv_indev_state_t wheel_state = LV_INDEV_STATE_RELEASED;
+static input_queue_t wheel_queue;
+static lv_indev_state_t wheel_state = LV_INDEV_STATE_RELEASED;     /*Producer side*/
+static lv_indev_state_t wheel_state_last = LV_INDEV_STATE_RELEASED;
 
-static char buf[KEYBOARD_BUFFER_SIZE];
+static input_queue_t keyboard_queue;
 
 /**********************
  *      MACROS
@@ -126,29 +250,52 @@ static char buf[KEYBOARD_BUFFER_SIZE];
 
 void sdl_init(void)
 {
-    /*Initialize the SDL*/
-    SDL_Init(SDL_INIT_VIDEO);
-
-    SDL_SetEventFilter(quit_filter, NULL);
+    sdl_common_init();
 
-    window_create(&monitor);
+    window_create(&monitor, SDL_HOR_RES, SDL_VER_RES, SDL_ZOOM);
 #if SDL_DUAL_DISPLAY
-    window_create(&monitor2);
+    window_create(&monitor2, SDL_HOR_RES, SDL_VER_RES, SDL_ZOOM);
+    if(sdl_headless) return;
+
     int x, y;
     SDL_GetWindowPosition(monitor2.window, &x, &y);
     SDL_SetWindowPosition(monitor.window, x + (SDL_HOR_RES * SDL_ZOOM) / 2 + 10, y);
     SDL_SetWindowPosition(monitor2.window, x - (SDL_HOR_RES * SDL_ZOOM) / 2 - 10, y);
 #endif
+}
 
-    SDL_StartTextInput();
+/**
+ * Open a new simulator window.
+ * @param hor_res horizontal resolution of the simulated display
+ * @param ver_res vertical resolution of the simulated display
+ * @param zoom scale the window by this factor
+ * @return the window's context or NULL on error
+ */
+sdl_window_t * sdl_window_create(lv_coord_t hor_res, lv_coord_t ver_res, int zoom)
+{
+    sdl_common_init();
 
-#if LV_TICK_CUSTOM == 0
-    /* Tick init.
-     * You have to call 'lv_tick_inc()' in periodically to inform LittelvGL about
-     * how much time were elapsed Create an SDL thread to do this*/
-    SDL_CreateThread(tick_thread, "tick", NULL);
-#endif
-    lv_timer_create(sdl_event_handler, 10, NULL);
+    monitor_t * m = calloc(1, sizeof(monitor_t));
+    if(m == NULL) return NULL;
+
+    window_create(m, hor_res, ver_res, zoom < 1 ? 1 : zoom);
+    if(sdl_headless ? m->headless_fb == NULL : (m->window == NULL || m->renderer == NULL || m->texture == NULL)) {
+        window_destroy(m);
+        free(m);
+        return NULL;
+    }
+
+    return m;
+}
+
+/**
+ * Close a window created by `sdl_window_create()`.
+ * @param win the window's context
+ */
+void sdl_window_delete(sdl_window_t * win)
+{
+    window_destroy(win);
+    free(win);
 }
 
 /**
@@ -159,51 +306,9 @@ void sdl_init(void)
  */
 void sdl_display_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p)
 {
-    lv_coord_t hres = disp_drv->hor_res;
-    lv_coord_t vres = disp_drv->ver_res;
-
-//    printf("x1:%d,y1:%d,x2:%d,y2:%d\n", area->x1, area->y1, area->x2, area->y2);
-
-    /*Return if the area is out the screen*/
-    if(area->x2 < 0 || area->y2 < 0 || area->x1 > hres - 1 || area->y1 > vres - 1) {
-        lv_disp_flush_ready(disp_drv);
-        return;
-    }
-
-#if SDL_DOUBLE_BUFFERED
-    monitor.tft_fb_act = (uint32_t *)color_p;
-#else /*SDL_DOUBLE_BUFFERED*/
-
-    int32_t y;
-#if LV_COLOR_DEPTH != 24 && LV_COLOR_DEPTH != 32    /*32 is valid but support 24 for backward compatibility too*/
-    int32_t x;
-    for(y = area->y1; y <= area->y2 && y < disp_drv->ver_res; y++) {
-        for(x = area->x1; x <= area->x2; x++) {
-            monitor.tft_fb[y * disp_drv->hor_res + x] = lv_color_to32(*color_p);
-            color_p++;
-        }
-
-    }
-#else
-    uint32_t w = lv_area_get_width(area);
-    for(y = area->y1; y <= area->y2 && y < disp_drv->ver_res; y++) {
-        memcpy(&monitor.tft_fb[y * SDL_HOR_RES + area->x1], color_p, w * sizeof(lv_color_t));
-        color_p += w;
-    }
-#endif
-#endif /*SDL_DOUBLE_BUFFERED*/
-
-    monitor.sdl_refr_qry = true;
-
-    /* TYPICALLY YOU DO NOT NEED THIS
-     * If it was the last part to refresh update the texture of the window.*/
-    if(lv_disp_flush_is_last(disp_drv)) {
-        monitor_sdl_refr(NULL);
-    }
-
-    /*IMPORTANT! It must be called to tell the system the flush is ready*/
-    lv_disp_flush_ready(disp_drv);
+    monitor_t * m = disp_drv->user_data ? disp_drv->user_data : &monitor;
 
+    window_flush(m, disp_drv, area, color_p);
 }
 
 
@@ -217,56 +322,24 @@ void sdl_display_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_colo
  */
 void sdl_display_flush2(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p)
 {
-    lv_coord_t hres = disp_drv->hor_res;
-    lv_coord_t vres = disp_drv->ver_res;
+    monitor_t * m = disp_drv->user_data ? disp_drv->user_data : &monitor2;
 
-    /*Return if the area is out the screen*/
-    if(area->x2 < 0 || area->y2 < 0 || area->x1 > hres - 1 || area->y1 > vres - 1) {
-        lv_disp_flush_ready(disp_drv);
-        return;
-    }
-
-#if SDL_DOUBLE_BUFFERED
-    monitor2.tft_fb_act = (uint32_t *)color_p;
-
-    monitor2.sdl_refr_qry = true;
-
-    /*IMPORTANT! It must be called to tell the system the flush is ready*/
-    lv_disp_flush_ready(disp_drv);
-#else
-
-    int32_t y;
-#if LV_COLOR_DEPTH != 24 && LV_COLOR_DEPTH != 32    /*32 is valid but support 24 for backward compatibility too*/
-    int32_t x;
-    for(y = area->y1; y <= area->y2 && y < disp_drv->ver_res; y++) {
-        for(x = area->x1; x <= area->x2; x++) {
-            monitor2.tft_fb[y * disp_drv->hor_res + x] = lv_color_to32(*color_p);
-            color_p++;
-        }
-
-    }
-#else
-    uint32_t w = lv_area_get_width(area);
-    for(y = area->y1; y <= area->y2 && y < disp_drv->ver_res; y++) {
-        memcpy(&monitor2.tft_fb[y * disp_drv->hor_res + area->x1], color_p, w * sizeof(lv_color_t));
-        color_p += w;
-    }
+    window_flush(m, disp_drv, area, color_p);
+}
 #endif
 
-    monitor2.sdl_refr_qry = true;
 
-    /* TYPICALLY YOU DO NOT NEED THIS
-     * If it was the last part to refresh update the texture of the window.*/
-    if(lv_disp_flush_is_last(disp_drv)) {
-        monitor_sdl_refr(NULL);
-    }
+/**
+ * Get the performance counters of a display's window
+ * @param disp pointer to the display or NULL for the default display
+ * @param perf store the counters here
+ */
+void sdl_get_perf(lv_disp_t * disp, sdl_perf_t * perf)
+{
+    monitor_t * m = monitor_from_disp(disp ? disp : lv_disp_get_default());
 
-    /*IMPORTANT! It must be called to tell the system the flush is ready*/
-    lv_disp_flush_ready(disp_drv);
-#endif
+    *perf = m->perf;
 }
-#endif
-
 
 /**
  * Get the current position and state of the mouse
@@ -275,15 +348,74 @@ void sdl_display_flush2(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_col
  */
 void sdl_mouse_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data)
 {
-    (void) indev_drv;      /*Unused*/
+    /*Read the window of the display the mouse belongs to*/
+    monitor_t * m = monitor_from_disp(indev_drv->disp);
+
+    /*Pass every queued event, so fast clicks and motion aren't lost*/
+    SDL_PumpEvents();
+    input_queue_pop(&m->mouse_queue, &m->mouse_last);
 
     /*Store the collected data*/
-    data->point.x = last_x;
-    data->point.y = last_y;
-    data->state = left_button_down ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    data->point = m->mouse_last.point;
+    data->state = m->mouse_last.state;
+    data->continue_reading = !input_queue_is_empty(&m->mouse_queue);
 }
 
 
+/**
+ * Get the state of the first finger touching the window
+ * @param indev_drv pointer to the related input device driver
+ * @param data store the touch data here
+ */
+void sdl_touch_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data)
+{
+    monitor_t * m = monitor_from_disp(indev_drv->disp);
+
+    SDL_PumpEvents();
+    input_queue_pop(&m->touch_queue, &m->touch_last);
+
+    data->point = m->touch_last.point;
+    data->state = m->touch_last.state;
+    data->continue_reading = !input_queue_is_empty(&m->touch_queue);
+}
+
+/**
+ * Get every finger touching the window of a display
+ * @param disp pointer to the display or NULL for the default display
+ * @param points store the fingers here
+ * @param max size of `points`
+ * @return number of fingers stored in `points`
+ */
+uint32_t sdl_touch_get_points(lv_disp_t * disp, sdl_touch_point_t * points, uint32_t max)
+{
+    monitor_t * m = monitor_from_disp(disp ? disp : lv_disp_get_default());
+
+    SDL_PumpEvents();
+
+    uint32_t cnt = LV_MIN(max, m->touch_point_cnt);
+    lv_memcpy(points, m->touch_points, cnt * sizeof(sdl_touch_point_t));
+    return cnt;
+}
+
+/**
+ * Get the multi-finger gesture done on the window of a display since the last call
+ * @param disp pointer to the display or NULL for the default display
+ * @param gesture store the gesture here
+ * @return true if there was a gesture
+ */
+bool sdl_touch_get_gesture(lv_disp_t * disp, sdl_touch_gesture_t * gesture)
+{
+    monitor_t * m = monitor_from_disp(disp ? disp : lv_disp_get_default());
+
+    SDL_PumpEvents();
+    if(!m->gesture_valid) return false;
+
+    *gesture = m->gesture;
+    lv_memset_00(&m->gesture, sizeof(m->gesture));
+    m->gesture_valid = false;
+    return true;
+}
+
 /**
  * Get encoder (i.e. mouse wheel) ticks difference and pressed state
  * @param indev_drv pointer to the related input device driver
@@ -293,9 +425,16 @@ void sdl_mousewheel_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data)
 {
     (void) indev_drv;      /*Unused*/
 
-    data->state = wheel_state;
-    data->enc_diff = wheel_diff;
-    wheel_diff = 0;
+    input_event_t e;
+
+    SDL_PumpEvents();
+    if(input_queue_pop(&wheel_queue, &e)) {
+        wheel_state_last = e.state;
+        data->enc_diff = e.enc_diff;
+    }
+
+    data->state = wheel_state_last;
+    data->continue_reading = !input_queue_is_empty(&wheel_queue);
 }
 
 /**
@@ -307,23 +446,16 @@ void sdl_keyboard_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data)
 {
     (void) indev_drv;      /*Unused*/
 
-    static bool dummy_read = false;
-    const size_t len = strlen(buf);
+    static input_event_t last;
+    input_event_t e;
 
-    /*Send a release manually*/
-    if (dummy_read) {
-        dummy_read = false;
-        data->state = LV_INDEV_STATE_RELEASED;
-        data->continue_reading = len > 0;
-    }
-    /*Send the pressed character*/
-    else if (len > 0) {
-        dummy_read = true;
-        data->state = LV_INDEV_STATE_PRESSED;
-        data->key = buf[0];
-        memmove(buf, buf + 1, len);
-        data->continue_reading = true;
-    }
+    /*Every character is queued as a press and a release*/
+    SDL_PumpEvents();
+    if(input_queue_pop(&keyboard_queue, &e)) last = e;
+
+    data->key = last.key;
+    data->state = last.state;
+    data->continue_reading = !input_queue_is_empty(&keyboard_queue);
 }
 
 
@@ -331,6 +463,125 @@ void sdl_keyboard_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data)
  *   STATIC FUNCTIONS
  **********************/
 
+/**
+ * Initialize SDL, the input handling and the tick once, no matter how many windows are created.
+ */
+static void sdl_common_init(void)
+{
+    if(sdl_inited) return;
+    sdl_inited = true;
+
+    /*Initialize the SDL*/
+    SDL_Init(SDL_INIT_VIDEO);
+
+    /*There is nothing to show the windows on with these video drivers*/
+    const char * video_driver = SDL_GetCurrentVideoDriver();
+    sdl_headless = SDL_HEADLESS;
+    if(video_driver && (strcmp(video_driver, "dummy") == 0 || strcmp(video_driver, "offscreen") == 0)) {
+        sdl_headless = true;
+    }
+    if(sdl_headless) atexit(headless_report);
+
+    SDL_SetEventFilter(quit_filter, NULL);
+
+#if SDL_MOUSE_TOUCH && defined(SDL_HINT_MOUSE_TOUCH_EVENTS)
+    SDL_SetHint(SDL_HINT_MOUSE_TOUCH_EVENTS, "1");
+#endif
+
+    /*Queue input events as soon as SDL receives them, whoever pumps the events*/
+    SDL_AddEventWatch(input_event_watch, NULL);
+
+    SDL_StartTextInput();
+
+#if LV_TICK_CUSTOM == 0
+    /* Tick init.
+     * You have to call 'lv_tick_inc()' in periodically to inform LittelvGL about
+     * how much time were elapsed Create an SDL thread to do this*/
+    SDL_CreateThread(tick_thread, "tick", NULL);
+#endif
+    lv_timer_create(sdl_event_handler, 10, NULL);
+}
+
+/**
+ * Flush an area to a window
+ * @param m pointer to the window
+ * @param disp_drv pointer to driver where this function belongs
+ * @param area an area where to copy `color_p`
+ * @param color_p an array of pixels to copy to the `area` part of the screen
+ */
+static void window_flush(monitor_t * m, lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p)
+{
+    lv_coord_t hres = disp_drv->hor_res;
+    lv_coord_t vres = disp_drv->ver_res;
+
+    /*Return if the area is out the screen*/
+    if(area->x2 < 0 || area->y2 < 0 || area->x1 > hres - 1 || area->y1 > vres - 1) {
+        lv_disp_flush_ready(disp_drv);
+        return;
+    }
+
+    uint32_t start = perf_get_us();
+    m->perf_acc.damaged_px += lv_area_get_size(area);
+
+    if(m->headless_fb) {
+        headless_flush(m, disp_drv, area, color_p);
+        return;
+    }
+
+    m->disp_drv = disp_drv;
+
+#if SDL_DOUBLE_BUFFERED
+    m->tft_fb_act = color_p;
+    monitor_add_dirty(m, area);
+#else
+    monitor_draw_area(m, area, color_p);
+#endif
+
+    m->sdl_refr_qry = true;
+    m->perf_acc.flush_us += perf_get_us() - start;
+
+    /* TYPICALLY YOU DO NOT NEED THIS
+     * If it was the last part to refresh update the texture of the window.*/
+    if(lv_disp_flush_is_last(disp_drv)) {
+        monitor_sdl_refr(NULL);
+    }
+
+    /*IMPORTANT! It must be called to tell the system the flush is ready*/
+    lv_disp_flush_ready(disp_drv);
+}
+
+/**
+ * Find the window an SDL event belongs to
+ * @param window_id ID of the SDL window
+ * @return the window or NULL if it's not one of ours
+ */
+static monitor_t * monitor_from_id(Uint32 window_id)
+{
+    monitor_t * m;
+    for(m = monitor_list; m; m = m->next) {
+        if(m->window_id == window_id) return m;
+    }
+
+    return NULL;
+}
+
+/**
+ * Find the window of a display
+ * @param disp pointer to a display or NULL
+ * @return the window, the first window if `disp` is NULL or isn't an SDL display
+ */
+static monitor_t * monitor_from_disp(lv_disp_t * disp)
+{
+    if(disp == NULL) return &monitor;
+
+    lv_disp_drv_t * disp_drv = disp->driver;
+    if(disp_drv->user_data) return disp_drv->user_data;
+#if SDL_DUAL_DISPLAY
+    if(disp_drv->flush_cb == sdl_display_flush2) return &monitor2;
+#endif
+    return &monitor;
+}
+
 
 /**
  * SDL main thread. All SDL related task have to be handled here!
@@ -344,27 +595,31 @@ static void sdl_event_handler(lv_timer_t * t)
     /*Refresh handling*/
     SDL_Event event;
     while(SDL_PollEvent(&event)) {
-        mouse_handler(&event);
-        mousewheel_handler(&event);
-        keyboard_handler(&event);
-
+        /*Input events are already queued by `input_event_watch`*/
         if((&event)->type == SDL_WINDOWEVENT) {
             switch((&event)->window.event) {
 #if SDL_VERSION_ATLEAST(2, 0, 5)
                 case SDL_WINDOWEVENT_TAKE_FOCUS:
 #endif
-                case SDL_WINDOWEVENT_EXPOSED:
-                    window_update(&monitor);
-#if SDL_DUAL_DISPLAY
-                    window_update(&monitor2);
-#endif
-                    break;
+                case SDL_WINDOWEVENT_EXPOSED: {
+                        /*Only mark it, a burst of expose events results in one present*/
+                        monitor_t * m = monitor_from_id(event.window.windowID);
+                        if(m) m->sdl_refr_qry = true;
+                        break;
+                    }
+                case SDL_WINDOWEVENT_SIZE_CHANGED: {
+                        monitor_t * m = monitor_from_id(event.window.windowID);
+                        if(m) window_resize(m, event.window.data1, event.window.data2);
+                        break;
+                    }
                 default:
                     break;
             }
         }
     }
 
+    monitor_sdl_refr(NULL);
+
     /*Run until quit event not arrives*/
     if(sdl_quit_qry) {
         monitor_sdl_clean_up();
@@ -382,17 +637,26 @@ static void monitor_sdl_refr(lv_timer_t * t)
     (void)t;
 
     /*Refresh handling*/
-    if(monitor.sdl_refr_qry != false) {
-        monitor.sdl_refr_qry = false;
-        window_update(&monitor);
+    monitor_t * m;
+    for(m = monitor_list; m; m = m->next) {
+        if(m->sdl_refr_qry != false && monitor_present_due(m)) {
+            m->sdl_refr_qry = false;
+            window_update(m);
+        }
     }
+}
 
-#if SDL_DUAL_DISPLAY
-    if(monitor2.sdl_refr_qry != false) {
-        monitor2.sdl_refr_qry = false;
-        window_update(&monitor2);
-    }
-#endif
+/**
+ * Check whether a display refresh elapsed since the last present.
+ * A deferred present is done by the next `sdl_event_handler` call.
+ * @param m pointer to the monitor
+ * @return true if the monitor can present again
+ */
+static bool monitor_present_due(monitor_t * m)
+{
+    if(m->present_period == 0) return true;
+
+    return SDL_GetTicks() - m->last_present >= m->present_period;
 }
 
 int quit_filter(void * userdata, SDL_Event * event)
@@ -413,144 +677,848 @@ int quit_filter(void * userdata, SDL_Event * event)
 
 static void monitor_sdl_clean_up(void)
 {
-    SDL_DestroyTexture(monitor.texture);
-    SDL_DestroyRenderer(monitor.renderer);
-    SDL_DestroyWindow(monitor.window);
-
-#if SDL_DUAL_DISPLAY
-    SDL_DestroyTexture(monitor2.texture);
-    SDL_DestroyRenderer(monitor2.renderer);
-    SDL_DestroyWindow(monitor2.window);
+    /*Report before the windows are gone*/
+    if(sdl_headless) headless_report();
 
-#endif
+    while(monitor_list) {
+        window_destroy(monitor_list);
+    }
 
     SDL_Quit();
 }
 
-static void window_create(monitor_t * m)
+static void window_create(monitor_t * m, lv_coord_t hor_res, lv_coord_t ver_res, int zoom)
 {
+    m->hor_res = hor_res;
+    m->ver_res = ver_res;
+    m->zoom = zoom;
+
+    if(sdl_headless) {
+        /*Keep the frame in memory only*/
+        m->headless_fb = calloc((size_t)hor_res * ver_res, sizeof(lv_color_t));
+        m->start_time = SDL_GetTicks();
+        m->next = monitor_list;
+        monitor_list = m;
+        return;
+    }
 
-    int flag = 0;
+    int flag = SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI;
 #if SDL_FULLSCREEN
     flag |= SDL_WINDOW_FULLSCREEN;
 #endif
 
     m->window = SDL_CreateWindow("TFT Simulator",
                               SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-                              SDL_HOR_RES * SDL_ZOOM, SDL_VER_RES * SDL_ZOOM, flag);       /*last param. SDL_WINDOW_BORDERLESS to hide borders*/
+                              hor_res * zoom, ver_res * zoom, flag);       /*last param. SDL_WINDOW_BORDERLESS to hide borders*/
+    m->window_id = SDL_GetWindowID(m->window);
+    SDL_SetWindowMinimumSize(m->window, zoom, zoom);
+
+    Uint32 renderer_flags = SDL_RENDERER_SOFTWARE;
+#if SDL_ACCELERATED
+    /*There is nothing to accelerate without a real video driver*/
+    const char * video_driver = SDL_GetCurrentVideoDriver();
+    if(video_driver == NULL || (strcmp(video_driver, "dummy") != 0 && strcmp(video_driver, "offscreen") != 0)) {
+        renderer_flags = SDL_RENDERER_ACCELERATED;
+    }
+#endif
+#if SDL_VSYNC
+    renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
+#endif
+
+    m->renderer = SDL_CreateRenderer(m->window, -1, renderer_flags);
+    if(m->renderer == NULL && (renderer_flags & SDL_RENDERER_ACCELERATED)) {
+        LV_LOG_WARN("accelerated renderer not available (%s), using the software renderer", SDL_GetError());
+        renderer_flags = (renderer_flags & ~SDL_RENDERER_ACCELERATED) | SDL_RENDERER_SOFTWARE;
+        m->renderer = SDL_CreateRenderer(m->window, -1, renderer_flags);
+    }
+
+    /*The renderer converts the mouse coordinates to the logical size in its own event watch.
+     *Register the input watch again to run after it.*/
+    SDL_DelEventWatch(input_event_watch, NULL);
+    SDL_AddEventWatch(input_event_watch, NULL);
+
+    /*Without vsync limit the presents to the refresh rate of the display*/
+    SDL_RendererInfo renderer_info;
+    SDL_DisplayMode mode;
+    m->present_period = 0;
+    if(SDL_GetRendererInfo(m->renderer, &renderer_info) != 0 || !(renderer_info.flags & SDL_RENDERER_PRESENTVSYNC)) {
+        if(SDL_GetWindowDisplayMode(m->window, &mode) == 0 && mode.refresh_rate > 0) {
+            m->present_period = 1000 / mode.refresh_rate;
+        }
+    }
+    /*Let the renderer scale the texture to the window (in integer steps, without filtering)
+     *instead of zooming the pixels on the CPU*/
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+    window_texture_create(m);
+
+    m->next = monitor_list;
+    monitor_list = m;
+}
+
+/**
+ * (Re)create the texture of a window with the window's resolution
+ * and scale it to the window.
+ * @param m pointer to the window
+ */
+static void window_texture_create(monitor_t * m)
+{
+    if(m->texture) SDL_DestroyTexture(m->texture);
 
-    m->renderer = SDL_CreateRenderer(m->window, -1, SDL_RENDERER_SOFTWARE);
     m->texture = SDL_CreateTexture(m->renderer,
-                                SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, SDL_HOR_RES, SDL_VER_RES);
+                                SDL_TEXTURE_FORMAT, SDL_TEXTUREACCESS_STREAMING, m->hor_res, m->ver_res);
     SDL_SetTextureBlendMode(m->texture, SDL_BLENDMODE_BLEND);
 
-    /*Initialize the frame buffer to gray (77 is an empirical value) */
+    SDL_RenderSetLogicalSize(m->renderer, m->hor_res, m->ver_res);
+    SDL_RenderSetIntegerScale(m->renderer, SDL_TRUE);
+
 #if SDL_DOUBLE_BUFFERED
-    SDL_UpdateTexture(m->texture, NULL, m->tft_fb_act, SDL_HOR_RES * sizeof(uint32_t));
+
+    /*Upload the whole texture first*/
+    m->dirty[0].x = 0;
+    m->dirty[0].y = 0;
+    m->dirty[0].w = m->hor_res;
+    m->dirty[0].h = m->ver_res;
+    m->dirty_cnt = 1;
 #else
-    m->tft_fb = (uint32_t *)malloc(sizeof(uint32_t) * SDL_HOR_RES * SDL_VER_RES);
-    memset(m->tft_fb, 0x44, SDL_HOR_RES * SDL_VER_RES * sizeof(uint32_t));
+    /*Initialize the texture to gray (77 is an empirical value) */
+    void * pixels;
+    int pitch;
+    if(m->texture && SDL_LockTexture(m->texture, NULL, &pixels, &pitch) == 0) {
+        memset(pixels, 0x44, pitch * m->ver_res);
+        SDL_UnlockTexture(m->texture);
+    }
 #endif
 
     m->sdl_refr_qry = true;
+}
+
+/**
+ * Adjust the resolution of a window's display to the new window size.
+ * Displays rendering into full screen sized buffers keep their resolution,
+ * and they are only scaled to the window.
+ * @param m pointer to the window
+ * @param w new width of the window
+ * @param h new height of the window
+ */
+static void window_resize(monitor_t * m, int w, int h)
+{
+#if SDL_DOUBLE_BUFFERED
+    /*The draw buffers are screen sized, the window is only scaled*/
+    LV_UNUSED(m);
+    LV_UNUSED(w);
+    LV_UNUSED(h);
+#else
+    lv_disp_drv_t * drv = m->disp_drv;
+    if(drv == NULL || drv->full_refresh || drv->direct_mode) return;
 
+    lv_coord_t hor_res = LV_MAX(w / m->zoom, 1);
+    lv_coord_t ver_res = LV_MAX(h / m->zoom, 1);
+    if(hor_res == m->hor_res && ver_res == m->ver_res) return;
+
+    lv_disp_t * disp;
+    for(disp = lv_disp_get_next(NULL); disp; disp = lv_disp_get_next(disp)) {
+        if(disp->driver == drv) break;
+    }
+    if(disp == NULL) return;
+
+    m->hor_res = hor_res;
+    m->ver_res = ver_res;
+    window_texture_create(m);
+
+    /*LVGL redraws the whole screen with the new resolution*/
+    drv->hor_res = hor_res;
+    drv->ver_res = ver_res;
+    lv_disp_drv_update(disp, drv);
+#endif
 }
 
-static void window_update(monitor_t * m)
+static void window_destroy(monitor_t * m)
+{
+    monitor_t ** p;
+    for(p = &monitor_list; *p; p = &(*p)->next) {
+        if(*p == m) {
+            *p = m->next;
+            break;
+        }
+    }
+
+    if(m->texture) SDL_DestroyTexture(m->texture);
+    if(m->renderer) SDL_DestroyRenderer(m->renderer);
+    if(m->window) SDL_DestroyWindow(m->window);
+    free(m->headless_fb);
+    m->texture = NULL;
+    m->renderer = NULL;
+    m->window = NULL;
+    m->headless_fb = NULL;
+}
+
+/**
+ * Copy a flushed area to the frame buffer of a headless window
+ * and save the frame if it's complete.
+ * @param m pointer to the window
+ * @param disp_drv pointer to driver where this function belongs
+ * @param area an area where to copy `color_p`
+ * @param color_p an array of pixels to copy to the `area` part of the screen
+ */
+static void headless_flush(monitor_t * m, lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p)
+{
+    uint32_t start = perf_get_us();
+    int32_t x1 = LV_MAX(area->x1, 0);
+    int32_t y1 = LV_MAX(area->y1, 0);
+    int32_t x2 = LV_MIN(area->x2, m->hor_res - 1);
+    int32_t y2 = LV_MIN(area->y2, m->ver_res - 1);
+    int32_t y;
+
+    /*With screen sized buffers `color_p` is the whole frame, else only the area*/
+#if SDL_DOUBLE_BUFFERED
+    bool full_frame = true;
+#else
+    bool full_frame = disp_drv->direct_mode;
+#endif
+    int32_t stride = full_frame ? m->hor_res : lv_area_get_width(area);
+    int32_t org_x = full_frame ? 0 : area->x1;
+    int32_t org_y = full_frame ? 0 : area->y1;
+
+    if(x1 <= x2 && y1 <= y2) {
+        const lv_color_t * src = color_p + (y1 - org_y) * stride + (x1 - org_x);
+        for(y = y1; y <= y2; y++) {
+            memcpy(m->headless_fb + y * m->hor_res + x1, src, (x2 - x1 + 1) * sizeof(lv_color_t));
+            src += stride;
+        }
+        m->flush_bytes += (uint64_t)(x2 - x1 + 1) * (y2 - y1 + 1) * sizeof(lv_color_t);
+    }
+
+    m->perf_acc.flush_us += perf_get_us() - start;
+
+    if(lv_disp_flush_is_last(disp_drv)) {
+        perf_frame_end(m);
+        if(SDL_DUMP_PERIOD > 0 && m->perf.frame_cnt % SDL_DUMP_PERIOD == 0) headless_dump(m);
+    }
+
+    lv_disp_flush_ready(disp_drv);
+}
+
+/**
+ * Save the frame of a headless window as binary PPM (P6) image
+ * @param m pointer to the window
+ */
+static void headless_dump(monitor_t * m)
+{
+    static FILE * stream = NULL;
+    FILE * f;
+    char path[256];
+    bool per_frame = strchr(SDL_DUMP_PATH, '%') != NULL;
+
+    if(per_frame) {
+        snprintf(path, sizeof(path), SDL_DUMP_PATH, (unsigned int)m->perf.frame_cnt);
+        f = fopen(path, "wb");
+    }
+    else {
+        /*All frames go to the same stream, e.g. to be encoded by ffmpeg later*/
+        if(stream == NULL) stream = fopen(SDL_DUMP_PATH, "wb");
+        f = stream;
+    }
+
+    if(f == NULL) {
+        LV_LOG_WARN("can't open %s", SDL_DUMP_PATH);
+        return;
+    }
+
+    uint8_t * row = malloc((size_t)m->hor_res * 3);
+    if(row) {
+        lv_coord_t x, y;
+        fprintf(f, "P6\n%d %d\n255\n", m->hor_res, m->ver_res);
+        for(y = 0; y < m->ver_res; y++) {
+            const lv_color_t * src = m->headless_fb + y * m->hor_res;
+            for(x = 0; x < m->hor_res; x++) {
+                lv_color32_t c;
+                c.full = lv_color_to32(src[x]);
+                row[x * 3 + 0] = c.ch.red;
+                row[x * 3 + 1] = c.ch.green;
+                row[x * 3 + 2] = c.ch.blue;
+            }
+            fwrite(row, 1, (size_t)m->hor_res * 3, f);
+        }
+        free(row);
+    }
+
+    if(per_frame) fclose(f);
+    else fflush(f);
+}
+
+/**
+ * Print the statistics of the headless windows. Called at exit.
+ */
+static void headless_report(void)
 {
-#if SDL_DOUBLE_BUFFERED == 0
-    SDL_UpdateTexture(m->texture, NULL, m->tft_fb, SDL_HOR_RES * sizeof(uint32_t));
+    static bool reported = false;
+    if(reported) return;
+    reported = true;
+
+    monitor_t * m;
+    for(m = monitor_list; m; m = m->next) {
+        if(m->headless_fb == NULL) continue;
+
+        uint32_t elapsed = SDL_GetTicks() - m->start_time;
+        printf("sdl: %dx%d: %u frames in %u ms (%.1f FPS), %llu bytes flushed (%.0f bytes/frame)\n",
+               m->hor_res, m->ver_res, (unsigned int)m->perf.frame_cnt, (unsigned int)elapsed,
+               elapsed ? m->perf.frame_cnt * 1000.0 / elapsed : 0.0,
+               (unsigned long long)m->flush_bytes,
+               m->perf.frame_cnt ? (double)m->flush_bytes / m->perf.frame_cnt : 0.0);
+    }
+}
+
+#if SDL_DOUBLE_BUFFERED
+
+/**
+ * Remember a flushed area to upload only the changed parts of the texture
+ * @param m pointer to the monitor
+ * @param area the flushed area
+ */
+static void monitor_add_dirty(monitor_t * m, const lv_area_t * area)
+{
+    SDL_Rect r;
+    uint32_t i;
+
+    r.x = LV_MAX(area->x1, 0);
+    r.y = LV_MAX(area->y1, 0);
+    r.w = LV_MIN(area->x2, m->hor_res - 1) - r.x + 1;
+    r.h = LV_MIN(area->y2, m->ver_res - 1) - r.y + 1;
+    if(r.w <= 0 || r.h <= 0) return;
+
+    /*Skip areas which are already covered*/
+    for(i = 0; i < m->dirty_cnt; i++) {
+        const SDL_Rect * d = &m->dirty[i];
+        if(r.x >= d->x && r.y >= d->y && r.x + r.w <= d->x + d->w && r.y + r.h <= d->y + d->h) return;
+    }
+
+    if(m->dirty_cnt < SDL_DIRTY_AREA_MAX) {
+        m->dirty[m->dirty_cnt] = r;
+        m->dirty_cnt++;
+        return;
+    }
+
+    /*Too many areas: merge everything into one bounding box*/
+    for(i = 0; i < m->dirty_cnt; i++) {
+        SDL_UnionRect(&r, &m->dirty[i], &r);
+    }
+    m->dirty[0] = r;
+    m->dirty_cnt = 1;
+}
 #else
+/**
+ * Convert a flushed area straight into the locked part of the streaming texture
+ * @param m pointer to the monitor
+ * @param area the flushed area
+ * @param color_p the pixels of `area`
+ */
+static void monitor_draw_area(monitor_t * m, const lv_area_t * area, lv_color_t * color_p)
+{
+    SDL_Rect r;
+
+    r.x = LV_MAX(area->x1, 0);
+    r.y = LV_MAX(area->y1, 0);
+    r.w = LV_MIN(area->x2, m->hor_res - 1) - r.x + 1;
+    r.h = LV_MIN(area->y2, m->ver_res - 1) - r.y + 1;
+    if(r.w <= 0 || r.h <= 0) return;
+
+    lv_coord_t w = lv_area_get_width(area);
+    m->perf_acc.upload_bytes += texture_write(m->texture, &r, color_p + (r.y - area->y1) * w + (r.x - area->x1), w);
+}
+#endif
+
+/**
+ * Convert a row of pixels to the texture's format
+ * @param dst destination in the texture
+ * @param src source pixels
+ * @param len number of pixels
+ */
+static void convert_row(void * dst, const lv_color_t * src, int32_t len)
+{
+#if LV_COLOR_DEPTH == 16 && LV_COLOR_16_SWAP
+    /*Plain byte swap, simple enough for the compiler to vectorize*/
+    uint16_t * d = dst;
+    const uint16_t * s = (const uint16_t *)src;
+    int32_t i;
+    for(i = 0; i < len; i++) {
+        d[i] = (uint16_t)((s[i] >> 8) | (s[i] << 8));
+    }
+#elif LV_COLOR_DEPTH == 32 || LV_COLOR_DEPTH == 24 || LV_COLOR_DEPTH == 16 || LV_COLOR_DEPTH == 8
+    /*The texture has the same format as lv_color_t*/
+    memcpy(dst, src, len * sizeof(lv_color_t));
+#else
+    uint32_t * d = dst;
+    int32_t i;
+    for(i = 0; i < len; i++) {
+        d[i] = lv_color_to32(src[i]);
+    }
+#endif
+}
+
+/**
+ * Write pixels into a part of the streaming texture
+ * @param texture the streaming texture
+ * @param r the part of the texture to write
+ * @param src pixels of the top left corner of `r`
+ * @param src_stride width of the source buffer in pixels
+ * @return number of bytes written to the texture
+ */
+static uint32_t texture_write(SDL_Texture * texture, const SDL_Rect * r, const lv_color_t * src, int32_t src_stride)
+{
+    void * pixels;
+    int pitch;
+    int32_t y;
+
+    /*The locked pixels are write-only, every pixel of `r` is written below*/
+    if(SDL_LockTexture(texture, r, &pixels, &pitch) != 0) return 0;
+
+    for(y = 0; y < r->h; y++) {
+        convert_row((uint8_t *)pixels + y * pitch, src, r->w);
+        src += src_stride;
+    }
+
+    SDL_UnlockTexture(texture);
+
+    return r->w * r->h * SDL_BYTESPERPIXEL(SDL_TEXTURE_FORMAT);
+}
+
+static void window_update(monitor_t * m)
+{
+    if(m->headless_fb) return;
+
+    uint32_t start = perf_get_us();
+
+#if SDL_DOUBLE_BUFFERED
     if(m->tft_fb_act == NULL) return;
-    SDL_UpdateTexture(m->texture, NULL, m->tft_fb_act, SDL_HOR_RES * sizeof(uint32_t));
+
+    /*Upload only the areas flushed since the last update*/
+    uint32_t i;
+    for(i = 0; i < m->dirty_cnt; i++) {
+        const SDL_Rect * r = &m->dirty[i];
+        m->perf_acc.upload_bytes += texture_write(m->texture, r, m->tft_fb_act + r->y * m->hor_res + r->x, m->hor_res);
+    }
+    m->dirty_cnt = 0;
 #endif
+
     SDL_RenderClear(m->renderer);
 #if LV_COLOR_SCREEN_TRANSP
     SDL_SetRenderDrawColor(m->renderer, 0xff, 0, 0, 0xff);
     SDL_Rect r;
-    r.x = 0; r.y = 0; r.w = SDL_HOR_RES; r.h = SDL_VER_RES;
+    r.x = 0; r.y = 0; r.w = m->hor_res; r.h = m->ver_res;
     SDL_RenderDrawRect(m->renderer, &r);
 #endif
 
     /*Update the renderer with the texture containing the rendered image*/
     SDL_RenderCopy(m->renderer, m->texture, NULL, NULL);
+#if SDL_PERF_HUD
+    perf_hud_draw(m);
+#endif
     SDL_RenderPresent(m->renderer);
+    m->last_present = SDL_GetTicks();
+
+    perf_frame_end(m);
+    m->perf.update_us = perf_get_us() - start;
+}
+
+/**
+ * Get a microsecond timestamp for the performance counters
+ * @return microseconds from an arbitrary point, wraps around
+ */
+static uint32_t perf_get_us(void)
+{
+    uint64_t cnt = SDL_GetPerformanceCounter();
+    uint64_t freq = SDL_GetPerformanceFrequency();
+
+    return (uint32_t)((cnt / freq) * 1000000 + (cnt % freq) * 1000000 / freq);
+}
+
+/**
+ * Publish the counters collected since the last frame
+ * @param m pointer to the window
+ */
+static void perf_frame_end(monitor_t * m)
+{
+    uint32_t frame_cnt = m->perf.frame_cnt + 1;
+    uint32_t fps = m->perf.fps;
+    uint32_t update_us = m->perf.update_us;
+
+    m->perf = m->perf_acc;
+    m->perf.frame_cnt = frame_cnt;
+    m->perf.fps = fps;
+    m->perf.update_us = update_us;
+    lv_memset_00(&m->perf_acc, sizeof(m->perf_acc));
+
+    uint32_t now = SDL_GetTicks();
+    m->perf_fps_frames++;
+    if(now - m->perf_fps_start >= 1000) {
+        m->perf.fps = m->perf_fps_frames * 1000 / (now - m->perf_fps_start);
+        m->perf_fps_frames = 0;
+        m->perf_fps_start = now;
+    }
+}
+
+#if SDL_PERF_HUD
+
+/**
+ * Draw a line of text with a 3x5 pixel font. Only digits, space and the letters used by the HUD are supported.
+ * @param renderer the renderer to draw with
+ * @param x left side of the text
+ * @param y top of the text
+ * @param text the text to draw
+ */
+static void perf_hud_text(SDL_Renderer * renderer, int x, int y, const char * text)
+{
+    static const uint16_t digits[10] = {
+        0x7b6f, 0x2c97, 0x73e7, 0x73cf, 0x5bc9, 0x79cf, 0x79ef, 0x7249, 0x7bef, 0x7bcf
+    };
+    static SDL_Rect rects[32 * 15];
+    int cnt = 0;
+
+    for(; *text && cnt <= (int)(sizeof(rects) / sizeof(rects[0])) - 15; text++, x += 4) {
+        uint16_t glyph;
+        if(*text >= '0' && *text <= '9') glyph = digits[*text - '0'];
+        else if(*text == 'B') glyph = 0x6bae;
+        else if(*text == 'F') glyph = 0x79a4;
+        else if(*text == 'L') glyph = 0x4927;
+        else if(*text == 'P') glyph = 0x6ba4;
+        else if(*text == 'S') glyph = 0x388e;
+        else if(*text == 'U') glyph = 0x5b6f;
+        else if(*text == 'X') glyph = 0x5aad;
+        else glyph = 0;
+
+        /*The bits are the rows from the top, MSB is the left pixel*/
+        int i;
+        for(i = 0; i < 15; i++) {
+            if(glyph & (1 << (14 - i))) {
+                rects[cnt].x = x + i % 3;
+                rects[cnt].y = y + i / 3;
+                rects[cnt].w = 1;
+                rects[cnt].h = 1;
+                cnt++;
+            }
+        }
+    }
+
+    SDL_RenderFillRects(renderer, rects, cnt);
+}
+
+/**
+ * Draw the performance counters on top of the window
+ * @param m pointer to the window
+ */
+static void perf_hud_draw(monitor_t * m)
+{
+    char line[3][32];
+    SDL_Rect bg;
+    SDL_BlendMode blend;
+    Uint8 r, g, b, a;
+
+    snprintf(line[0], sizeof(line[0]), "FPS %u", (unsigned int)m->perf.fps);
+    snprintf(line[1], sizeof(line[1]), "FL %uUS UP %uUS", (unsigned int)m->perf.flush_us, (unsigned int)m->perf.update_us);
+    snprintf(line[2], sizeof(line[2]), "PX %u B %u", (unsigned int)m->perf.damaged_px, (unsigned int)m->perf.upload_bytes);
+
+    bg.x = 0;
+    bg.y = 0;
+    bg.w = 4 * 24 + 2;
+    bg.h = 3 * 6 + 2;
+
+    /*Keep the renderer's state, the next SDL_RenderClear uses its draw color*/
+    SDL_GetRenderDrawBlendMode(m->renderer, &blend);
+    SDL_GetRenderDrawColor(m->renderer, &r, &g, &b, &a);
+
+    SDL_SetRenderDrawBlendMode(m->renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(m->renderer, 0, 0, 0, 0xa0);
+    SDL_RenderFillRect(m->renderer, &bg);
+
+    SDL_SetRenderDrawColor(m->renderer, 0x40, 0xff, 0x40, 0xff);
+    int i;
+    for(i = 0; i < 3; i++) {
+        perf_hud_text(m->renderer, 2, 2 + i * 6, line[i]);
+    }
+
+    SDL_SetRenderDrawColor(m->renderer, r, g, b, a);
+    SDL_SetRenderDrawBlendMode(m->renderer, blend);
+}
+#endif
+
+/**
+ * Called by SDL for every new event, from the thread pumping the events.
+ * @param userdata unused
+ * @param event the new event
+ * @return ignored
+ */
+static int input_event_watch(void * userdata, SDL_Event * event)
+{
+    (void)userdata;
+
+    mouse_handler(event);
+    touch_handler(event);
+    mousewheel_handler(event);
+    keyboard_handler(event);
+
+    return 0;
+}
+
+/**
+ * Add an event to a queue. Must be called only from the producer.
+ * The last slots are kept for state changes, so when the consumer falls behind
+ * only motion is dropped and a press is never left without its release.
+ * @param q pointer to the queue
+ * @param e the event to add
+ * @param motion true if `e` only moves the point, a later event carries the newer position anyway
+ * @return false if the queue is full and the event was dropped
+ */
+static bool input_queue_push(input_queue_t * q, const input_event_t * e, bool motion)
+{
+    int head = SDL_AtomicGet(&q->head);
+    int tail = SDL_AtomicGet(&q->tail);
+    int limit = motion ? SDL_INPUT_QUEUE_SIZE - INPUT_QUEUE_STATE_RESERVE : SDL_INPUT_QUEUE_SIZE;
+
+    if(head - tail >= limit) return false;
+
+    q->events[head & (SDL_INPUT_QUEUE_SIZE - 1)] = *e;
+
+    /*Publish the event only after it's written*/
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&q->head, head + 1);
+
+    return true;
+}
+
+/**
+ * Take the oldest event from a queue. Must be called only from the consumer.
+ * @param q pointer to the queue
+ * @param e store the event here
+ * @return false if the queue is empty
+ */
+static bool input_queue_pop(input_queue_t * q, input_event_t * e)
+{
+    int tail = SDL_AtomicGet(&q->tail);
+    int head = SDL_AtomicGet(&q->head);
+
+    if(head == tail) return false;
+
+    SDL_MemoryBarrierAcquire();
+    *e = q->events[tail & (SDL_INPUT_QUEUE_SIZE - 1)];
+    SDL_AtomicSet(&q->tail, tail + 1);
+
+    return true;
+}
+
+static bool input_queue_is_empty(input_queue_t * q)
+{
+    return SDL_AtomicGet(&q->head) == SDL_AtomicGet(&q->tail);
 }
 
 static void mouse_handler(SDL_Event * event)
 {
+    monitor_t * m = NULL;
+
     switch(event->type) {
         case SDL_MOUSEBUTTONUP:
-            if(event->button.button == SDL_BUTTON_LEFT)
-                left_button_down = false;
-            break;
         case SDL_MOUSEBUTTONDOWN:
-            if(event->button.button == SDL_BUTTON_LEFT) {
-                left_button_down = true;
-                last_x = event->motion.x / SDL_ZOOM;
-                last_y = event->motion.y / SDL_ZOOM;
-            }
+            if(event->button.button != SDL_BUTTON_LEFT) break;
+            m = monitor_from_id(event->button.windowID);
+            if(m == NULL) break;
+            m->mouse_in.state = event->type == SDL_MOUSEBUTTONDOWN ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+            m->mouse_in.point.x = event->button.x;
+            m->mouse_in.point.y = event->button.y;
             break;
         case SDL_MOUSEMOTION:
-            last_x = event->motion.x / SDL_ZOOM;
-            last_y = event->motion.y / SDL_ZOOM;
+            m = monitor_from_id(event->motion.windowID);
+            if(m == NULL) break;
+            m->mouse_in.point.x = event->motion.x;
+            m->mouse_in.point.y = event->motion.y;
+            break;
+        default:
+            /*Touches are also emulated as mouse events by SDL*/
             break;
+    }
 
+    if(m) {
+        m->mouse_in.timestamp = event->common.timestamp;
+        input_queue_push(&m->mouse_queue, &m->mouse_in, event->type == SDL_MOUSEMOTION);
+    }
+}
+
+/**
+ * Called from the SDL event watch to track the fingers and gestures
+ * @param event describes the event
+ */
+static void touch_handler(SDL_Event * event)
+{
+    monitor_t * m = NULL;
+    uint32_t i;
+
+    switch(event->type) {
         case SDL_FINGERUP:
-            left_button_down = false;
-            last_x = LV_HOR_RES * event->tfinger.x / SDL_ZOOM;
-            last_y = LV_VER_RES * event->tfinger.y / SDL_ZOOM;
-            break;
         case SDL_FINGERDOWN:
-            left_button_down = true;
-            last_x = LV_HOR_RES * event->tfinger.x / SDL_ZOOM;
-            last_y = LV_VER_RES * event->tfinger.y / SDL_ZOOM;
-            break;
         case SDL_FINGERMOTION:
-            last_x = LV_HOR_RES * event->tfinger.x / SDL_ZOOM;
-            last_y = LV_VER_RES * event->tfinger.y / SDL_ZOOM;
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+            m = monitor_from_id(event->tfinger.windowID);
+#endif
+            if(m == NULL) m = monitor_list;
+            if(m == NULL) return;
             break;
+        case SDL_MULTIGESTURE:
+            /*Gestures don't tell the window, use the one being touched*/
+            for(m = monitor_list; m; m = m->next) {
+                if(m->touch_point_cnt > 0) break;
+            }
+            if(m == NULL) return;
+
+            touch_to_disp(m, event->mgesture.x, event->mgesture.y, &m->gesture.center);
+            m->gesture.rotation += event->mgesture.dTheta;
+            m->gesture.pinch += event->mgesture.dDist;
+            m->gesture.finger_cnt = event->mgesture.numFingers;
+            m->gesture_valid = true;
+            return;
+        default:
+            return;
+    }
+
+    lv_point_t p;
+    bool on_disp = touch_to_disp(m, event->tfinger.x, event->tfinger.y, &p);
+
+    for(i = 0; i < m->touch_point_cnt; i++) {
+        if(m->touch_points[i].id == event->tfinger.fingerId) break;
+    }
+
+    /*Drop touches on the bars around the display, but release a lifted finger where it was last seen*/
+    if(!on_disp) {
+        if(event->type != SDL_FINGERUP || i == m->touch_point_cnt) return;
+        p = m->touch_points[i].point;
     }
 
+    if(event->type == SDL_FINGERUP) {
+        if(i < m->touch_point_cnt) {
+            m->touch_point_cnt--;
+            m->touch_points[i] = m->touch_points[m->touch_point_cnt];
+        }
+    }
+    else {
+        if(i == m->touch_point_cnt) {
+            if(m->touch_point_cnt == SDL_TOUCH_POINT_MAX) return;
+            m->touch_point_cnt++;
+            m->touch_points[i].id = event->tfinger.fingerId;
+        }
+        m->touch_points[i].point = p;
+        m->touch_points[i].pressure = event->tfinger.pressure;
+    }
+
+    /*The touch indev follows the first finger until it's lifted*/
+    if(m->touch_in.state == LV_INDEV_STATE_RELEASED) {
+        if(event->type != SDL_FINGERDOWN) return;
+        m->touch_primary = event->tfinger.fingerId;
+    }
+    else if(m->touch_primary != event->tfinger.fingerId) {
+        return;
+    }
+
+    m->touch_in.point = p;
+    m->touch_in.state = event->type == SDL_FINGERUP ? LV_INDEV_STATE_RELEASED : LV_INDEV_STATE_PRESSED;
+    m->touch_in.timestamp = event->common.timestamp;
+    input_queue_push(&m->touch_queue, &m->touch_in, event->type == SDL_FINGERMOTION);
+}
+
+/**
+ * Map a finger position to the display, which is letterboxed by the logical size of the renderer
+ * @param m pointer to the window
+ * @param x horizontal position normalized to the window (0..1)
+ * @param y vertical position normalized to the window (0..1)
+ * @param p store the position on the display here
+ * @return false if the position is on the bars around the display
+ */
+static bool touch_to_disp(monitor_t * m, float x, float y, lv_point_t * p)
+{
+    int out_w;
+    int out_h;
+    float scale_x;
+    float scale_y;
+    SDL_Rect vp;
+
+    if(m->renderer == NULL || SDL_GetRendererOutputSize(m->renderer, &out_w, &out_h) != 0) {
+        p->x = m->hor_res * x;
+        p->y = m->ver_res * y;
+        return true;
+    }
+
+    SDL_RenderGetScale(m->renderer, &scale_x, &scale_y);
+    SDL_RenderGetViewport(m->renderer, &vp);
+    if(scale_x <= 0.0f || scale_y <= 0.0f) return false;
+
+    /*The viewport is in logical coordinates, its offset is the width of the bars*/
+    float lx = x * out_w / scale_x - vp.x;
+    float ly = y * out_h / scale_y - vp.y;
+    p->x = (lv_coord_t)lx;
+    p->y = (lv_coord_t)ly;
+
+    return lx >= 0.0f && ly >= 0.0f && lx < vp.w && ly < vp.h;
 }
 
 
 /**
- * It is called periodically from the SDL thread to check mouse wheel state
+ * Called from the SDL event watch to queue mouse wheel events
  * @param event describes the event
  */
 static void mousewheel_handler(SDL_Event * event)
 {
+    input_event_t e;
+    lv_memset_00(&e, sizeof(e));
+
     switch(event->type) {
         case SDL_MOUSEWHEEL:
             // Scroll down (y = -1) means positive encoder turn,
             // so invert it
 #ifdef __EMSCRIPTEN__
             /*Escripten scales it wrong*/
-            if(event->wheel.y < 0) wheel_diff++;
-            if(event->wheel.y > 0) wheel_diff--;
+            if(event->wheel.y < 0) e.enc_diff = 1;
+            if(event->wheel.y > 0) e.enc_diff = -1;
 #else
-            wheel_diff = -event->wheel.y;
+            e.enc_diff = -event->wheel.y;
 #endif
             break;
         case SDL_MOUSEBUTTONDOWN:
-            if(event->button.button == SDL_BUTTON_MIDDLE) {
-                wheel_state = LV_INDEV_STATE_PRESSED;
-            }
+            if(event->button.button != SDL_BUTTON_MIDDLE) return;
+            wheel_state = LV_INDEV_STATE_PRESSED;
             break;
         case SDL_MOUSEBUTTONUP:
-            if(event->button.button == SDL_BUTTON_MIDDLE) {
-                wheel_state = LV_INDEV_STATE_RELEASED;
-            }
+            if(event->button.button != SDL_BUTTON_MIDDLE) return;
+            wheel_state = LV_INDEV_STATE_RELEASED;
             break;
         default:
-            break;
+            return;
     }
+
+    e.timestamp = event->common.timestamp;
+    e.state = wheel_state;
+    input_queue_push(&wheel_queue, &e, event->type == SDL_MOUSEWHEEL);
 }
 
 
 /**
- * Called periodically from the SDL thread, store text input or control characters in the buffer.
+ * Queue a key press and release
+ * @param key the character or LV_KEY_* control character
+ * @param timestamp timestamp of the SDL event
+ */
+static void keyboard_queue_key(uint32_t key, uint32_t timestamp)
+{
+    input_event_t e;
+    lv_memset_00(&e, sizeof(e));
+
+    /*Only queue the key if its release fits too*/
+    if(SDL_AtomicGet(&keyboard_queue.head) - SDL_AtomicGet(&keyboard_queue.tail) > SDL_INPUT_QUEUE_SIZE - 2) return;
+
+    e.timestamp = timestamp;
+    e.key = key;
+    e.state = LV_INDEV_STATE_PRESSED;
+    input_queue_push(&keyboard_queue, &e, false);
+    e.state = LV_INDEV_STATE_RELEASED;
+    input_queue_push(&keyboard_queue, &e, false);
+}
+
+/**
+ * Called from the SDL event watch, queue text input or control characters.
  * @param event describes the event
  */
 static void keyboard_handler(SDL_Event * event)
@@ -562,18 +1530,15 @@ static void keyboard_handler(SDL_Event * event)
                 const uint32_t ctrl_key = keycode_to_ctrl_key(event->key.keysym.sym);
                 if (ctrl_key == '\0')
                     return;
-                const size_t len = strlen(buf);
-                if (len < KEYBOARD_BUFFER_SIZE - 1) {
-                    buf[len] = ctrl_key;
-                    buf[len + 1] = '\0';
-                }
+                keyboard_queue_key(ctrl_key, event->common.timestamp);
                 break;
             }
         case SDL_TEXTINPUT:                     /*Text input*/
             {
-                const size_t len = strlen(buf) + strlen(event->text.text);
-                if (len < KEYBOARD_BUFFER_SIZE - 1)
-                    strcat(buf, event->text.text);
+                const char * c;
+                for(c = event->text.text; *c != '\0'; c++) {
+                    keyboard_queue_key((uint8_t)*c, event->common.timestamp);
+                }
             }
             break;
         default:
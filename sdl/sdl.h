@@ -36,6 +36,33 @@ extern "C" {
 /**********************
  *      TYPEDEFS
  **********************/
+/*Context of a simulator window, store it in the display driver's `user_data`*/
+typedef struct _sdl_window_t sdl_window_t;
+
+/*Performance counters of a window*/
+typedef struct {
+    uint32_t frame_cnt;     /*Number of frames presented (rendered in headless mode)*/
+    uint32_t fps;           /*Frames in the last second*/
+    uint32_t flush_us;      /*Time spent in the flush callback for the last frame*/
+    uint32_t update_us;     /*Time spent uploading and presenting the last frame*/
+    uint32_t damaged_px;    /*Pixels flushed for the last frame*/
+    uint32_t upload_bytes;  /*Bytes written to the texture for the last frame*/
+} sdl_perf_t;
+
+/*A finger touching a window*/
+typedef struct {
+    int64_t id;             /*SDL's finger ID*/
+    lv_point_t point;
+    float pressure;         /*0..1*/
+} sdl_touch_point_t;
+
+/*Multi-finger gesture summed since the last query*/
+typedef struct {
+    lv_point_t center;      /*Center of the fingers*/
+    float rotation;         /*Rotation of the fingers [rad]*/
+    float pinch;            /*Change of the fingers' distance, relative to the window's diagonal*/
+    uint16_t finger_cnt;
+} sdl_touch_gesture_t;
 
 /**********************
  * GLOBAL PROTOTYPES
@@ -46,6 +73,24 @@ extern "C" {
  */
 void sdl_init(void);
 
+/**
+ * Open a simulator window. Any number of windows can be created at runtime.
+ * Store the returned context in `disp_drv->user_data` and use `sdl_display_flush` as `flush_cb`.
+ * Mouse input is read from the window of the display the input device is assigned to.
+ * `sdl_init()` doesn't need to be called if only this function is used to create windows.
+ * @param hor_res horizontal resolution of the simulated display
+ * @param ver_res vertical resolution of the simulated display
+ * @param zoom scale the window by this factor
+ * @return the window's context or NULL on error
+ */
+sdl_window_t * sdl_window_create(lv_coord_t hor_res, lv_coord_t ver_res, int zoom);
+
+/**
+ * Close a window created by `sdl_window_create()`.
+ * @param win the window's context
+ */
+void sdl_window_delete(sdl_window_t * win);
+
 /**
  * Flush a buffer to the marked area
  * @param disp_drv pointer to driver where this function belongs
@@ -62,6 +107,13 @@ void sdl_display_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_colo
  */
 void sdl_display_flush2(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p);
 
+/**
+ * Get the performance counters of a display's window
+ * @param disp pointer to the display or NULL for the default display
+ * @param perf store the counters here
+ */
+void sdl_get_perf(lv_disp_t * disp, sdl_perf_t * perf);
+
 /**
  * Get the current position and state of the mouse
  * @param indev_drv pointer to the related input device driver
@@ -69,6 +121,30 @@ void sdl_display_flush2(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_col
  */
 void sdl_mouse_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data);
 
+/**
+ * Get the state of the first finger touching the window
+ * @param indev_drv pointer to the related input device driver
+ * @param data store the touch data here
+ */
+void sdl_touch_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data);
+
+/**
+ * Get every finger touching the window of a display
+ * @param disp pointer to the display or NULL for the default display
+ * @param points store the fingers here
+ * @param max size of `points`
+ * @return number of fingers stored in `points`
+ */
+uint32_t sdl_touch_get_points(lv_disp_t * disp, sdl_touch_point_t * points, uint32_t max);
+
+/**
+ * Get the multi-finger gesture done on the window of a display since the last call
+ * @param disp pointer to the display or NULL for the default display
+ * @param gesture store the gesture here
+ * @return true if there was a gesture
+ */
+bool sdl_touch_get_gesture(lv_disp_t * disp, sdl_touch_gesture_t * gesture);
+
 /**
  * Get encoder (i.e. mouse wheel) ticks difference and pressed state
  * @param indev_drv pointer to the related input device driver
@@ -14,7 +14,26 @@
 #endif
 
 
+#ifndef SDL_GLES_PBO
+# define SDL_GLES_PBO 0
+#endif
+
+#ifndef SDL_GLES_HEADLESS
+# define SDL_GLES_HEADLESS 0
+#endif
+
+#ifndef SDL_GLES_ROTATION
+# define SDL_GLES_ROTATION 0
+#endif
+
+#ifndef SDL_GLES_LINEAR_FILTER
+# define SDL_GLES_LINEAR_FILTER 0
+#endif
+
 #include LV_GPU_GLES_EPOXY_INCLUDE_PATH
+#if SDL_GLES_HEADLESS
+#include <epoxy/egl.h>
+#endif
 #include SDL_INCLUDE_PATH
 
 /*********************
@@ -24,7 +43,28 @@
 #define KEYBOARD_BUFFER_SIZE SDL_TEXTINPUTEVENT_TEXT_SIZE
 #endif
 #if LV_USE_GPU_GLES_SW_MIXED
+/*16 bit colors can be uploaded as they are, others are converted to RGB*/
+#if LV_COLOR_DEPTH == 16
+    #define BYTES_PER_PIXEL 2
+    #define TEXTURE_TYPE GL_UNSIGNED_SHORT_5_6_5
+#else
     #define BYTES_PER_PIXEL 3
+    #define TEXTURE_TYPE GL_UNSIGNED_BYTE
+#endif
+#endif
+
+/*Size of the window, the display is rotated in it*/
+#if SDL_GLES_ROTATION == 90 || SDL_GLES_ROTATION == 270
+    #define WINDOW_HOR_RES (SDL_VER_RES * SDL_ZOOM)
+    #define WINDOW_VER_RES (SDL_HOR_RES * SDL_ZOOM)
+#else
+    #define WINDOW_HOR_RES (SDL_HOR_RES * SDL_ZOOM)
+    #define WINDOW_VER_RES (SDL_VER_RES * SDL_ZOOM)
+#endif
+
+/*Number of flushed areas uploaded per frame from a PBO. More areas are merged into their bounding box*/
+#ifndef SDL_DIRTY_AREA_MAX
+#define SDL_DIRTY_AREA_MAX 16
 #endif
 /**********************
  *      TYPEDEFS
@@ -32,15 +72,40 @@
 typedef struct {
     SDL_Window *window;
     SDL_GLContext *context;
+#if SDL_GLES_HEADLESS
+    EGLDisplay egl_display;
+    EGLContext egl_context;
+    EGLSurface egl_surface;     /*A pbuffer or EGL_NO_SURFACE if surfaceless contexts are supported*/
+#endif
+    GLuint present_fbo;         /*Where the frames are presented, 0: the window*/
+    GLuint present_texture;
+
+    /*Time spent in each step summed over `frame_cnt` frames [us]*/
+    uint64_t upload_us;
+    uint64_t draw_us;
+    uint64_t swap_us;
+    uint32_t frame_cnt;
 
     GLuint program;
     GLint position_location;
     GLint uv_location;
+    GLint lut_enabled_location;
+    GLuint vbo;                 /*The vertices of the presented quad*/
 
     GLuint texture;
+    GLuint lut_texture;         /*256x1 color correction table*/
 
 #if LV_USE_GPU_GLES_SW_MIXED
     GLubyte *texture_pixels;
+    const GLubyte *pixels;      /*The screen sized buffer to upload from: `texture_pixels` or LVGL's buffer*/
+    bool unpack_row_length;     /*GL_UNPACK_ROW_LENGTH is supported*/
+#if SDL_GLES_PBO
+    bool pbo_enabled;           /*The context supports pixel buffer objects*/
+    GLuint pbo[2];
+    uint32_t pbo_act;           /*The PBO to fill next, the other one may still be read by the GPU*/
+    lv_area_t dirty[SDL_DIRTY_AREA_MAX];    /*Areas flushed in this frame*/
+    uint32_t dirty_cnt;
+#endif
 #else
     GLuint framebuffer;
 #endif /* LV_USE_GPU_GLES_SW_MIXED */
@@ -54,18 +119,27 @@ typedef struct {
 static void window_create(monitor_t * m);
 static void window_update(monitor_t * m);
 static void monitor_sdl_gles_clean_up(void);
+static uint32_t perf_get_us(void);
+#if SDL_GLES_HEADLESS
+static bool egl_create(monitor_t * m);
+static void headless_report(void);
+#endif
 static void sdl_gles_event_handler(lv_timer_t * t);
 static void monitor_sdl_gles_refr(lv_timer_t * t);
 static void mouse_handler(SDL_Event *event);
+static void window_to_disp(int32_t wx, int32_t wy);
 static void keyboard_handler(SDL_Event * event);
 static uint32_t keycode_to_ctrl_key(SDL_Keycode sdl_key);
 static int tick_thread(void *data);
 static GLuint gl_shader_program_create(const char *vertex_src, const char *fragment_src);
 #if LV_USE_GPU_GLES_SW_MIXED
 static GLuint gl_texture_create(int width, int height, GLubyte *pixels);
-
-// From the article https://lupyuen.github.io/pinetime-rust-mynewt/articles/wayland
-static void put_px(uint16_t x, uint16_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+static void convert_row(GLubyte * dst, const lv_color_t * src, int32_t len);
+static void texture_upload(monitor_t * m, const lv_area_t * area);
+#if SDL_GLES_PBO
+static void monitor_add_dirty(monitor_t * m, const lv_area_t * area);
+static void texture_upload_pbo(monitor_t * m);
+#endif
 #endif /* LV_USE_GPU_GLES_SW_MIXED */
 
 /**********************
@@ -81,23 +155,35 @@ static int16_t last_y = 0;
 static char buf[KEYBOARD_BUFFER_SIZE];
 
 
+/*Rotation is done by rotating the texture coordinates around the center*/
 static char vertex_shader_str[] =
     "attribute vec2 a_position;   \n"
     "attribute vec2 a_texcoord;   \n"
+    "uniform mat2 u_uv_rot;       \n"
     "varying vec2 v_texcoord;     \n"
     "void main()                  \n"
     "{                            \n"
     "   gl_Position = vec4(a_position.x, a_position.y, 0.0, 1.0); \n"
-    "   v_texcoord = a_texcoord;  \n"
+    "   v_texcoord = u_uv_rot * (a_texcoord - 0.5) + 0.5;  \n"
     "}                            \n";
 
+/*The color correction table is sampled in the middle of its texels*/
 static char fragment_shader_str[] =
     "precision mediump float;                            \n"
     "varying vec2 v_texcoord;                            \n"
     "uniform sampler2D s_texture;                        \n"
+    "uniform sampler2D s_lut;                            \n"
+    "uniform float u_lut_enabled;                        \n"
     "void main()                                         \n"
     "{                                                   \n"
-    "  gl_FragColor = texture2D(s_texture, v_texcoord );\n"
+    "  vec4 c = texture2D(s_texture, v_texcoord);        \n"
+    "  if(u_lut_enabled > 0.5) {                         \n"
+    "    vec3 i = c.rgb * (255.0 / 256.0) + 0.5 / 256.0; \n"
+    "    c.r = texture2D(s_lut, vec2(i.r, 0.5)).r;       \n"
+    "    c.g = texture2D(s_lut, vec2(i.g, 0.5)).g;       \n"
+    "    c.b = texture2D(s_lut, vec2(i.b, 0.5)).b;       \n"
+    "  }                                                 \n"
+    "  gl_FragColor = c;                                 \n"
     "}                                                   \n";
 
 
@@ -131,7 +217,13 @@ static GLfloat vertices[] = {
 
 void sdl_gles_init(void)
 {
+#if SDL_GLES_HEADLESS
+    /*Only the timer and thread functions are used*/
+    SDL_Init(0);
+    atexit(headless_report);
+#else
     SDL_Init(SDL_INIT_VIDEO);
+#endif
 
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
@@ -165,7 +257,12 @@ void sdl_gles_disp_drv_init(lv_disp_drv_t *driver, lv_disp_draw_buf_t *draw_buf)
     driver->hor_res = SDL_HOR_RES;
     driver->ver_res = SDL_VER_RES;
     driver->direct_mode = 1;
+#if LV_USE_GPU_GLES_SW_MIXED
+    /*Only the changed areas are rendered, converted and uploaded*/
+    driver->full_refresh = 0;
+#else
     driver->full_refresh = 1;
+#endif
 #if !LV_USE_GPU_GLES_SW_MIXED
     driver->user_data = &monitor.framebuffer;
 #endif /* !LV_USE_GPU_GLES_SW_MIXED */
@@ -177,23 +274,60 @@ void sdl_gles_display_flush(lv_disp_drv_t * disp_drv,
                             const lv_area_t * area, lv_color_t * color_p)
 {
 #if LV_USE_GPU_GLES_SW_MIXED
-    int32_t x;
-    int32_t y;
-    for (y = area->y1; y <= area->y2; y++) {
-        for (x = area->x1; x <= area->x2; x++) {
-            /* Put a pixel to the display */
-            put_px(x, y,
-                   color_p->ch.red,
-                   color_p->ch.green,
-                   color_p->ch.blue,
-                   0xff);
-            color_p++;
+    lv_area_t a;
+    a.x1 = LV_MAX(area->x1, 0);
+    a.y1 = LV_MAX(area->y1, 0);
+    a.x2 = LV_MIN(area->x2, SDL_HOR_RES - 1);
+    a.y2 = LV_MIN(area->y2, SDL_VER_RES - 1);
+
+    if(a.x1 <= a.x2 && a.y1 <= a.y2) {
+        /*In direct mode `color_p` is the whole screen, else only the area*/
+        const lv_color_t * src;
+        int32_t src_stride;
+        if(disp_drv->direct_mode) {
+            src_stride = disp_drv->hor_res;
+            src = color_p + a.y1 * src_stride + a.x1;
+        }
+        else {
+            src_stride = lv_area_get_width(area);
+            src = color_p + (a.y1 - area->y1) * src_stride + (a.x1 - area->x1);
+        }
+
+#if LV_COLOR_DEPTH == 16 && LV_COLOR_16_SWAP == 0
+        if(disp_drv->direct_mode && src_stride == SDL_HOR_RES) {
+            /*The texture has the same format, upload straight from LVGL's buffer*/
+            monitor.pixels = (const GLubyte *)color_p;
+        }
+        else
+#endif
+        {
+            int32_t w = lv_area_get_width(&a);
+            int32_t y;
+            for(y = a.y1; y <= a.y2; y++) {
+                convert_row(monitor.texture_pixels + (y * SDL_HOR_RES + a.x1) * BYTES_PER_PIXEL, src, w);
+                src += src_stride;
+            }
+            monitor.pixels = monitor.texture_pixels;
         }
+
+        uint32_t start = perf_get_us();
+#if SDL_GLES_PBO
+        if(monitor.pbo_enabled) monitor_add_dirty(&monitor, &a);
+        else
+#endif
+            texture_upload(&monitor, &a);
+        monitor.upload_us += perf_get_us() - start;
+        monitor.sdl_refr_qry = true;
+    }
+
+    if(lv_disp_flush_is_last(disp_drv)) {
+#if SDL_GLES_PBO
+        uint32_t start = perf_get_us();
+        if(monitor.pbo_enabled) texture_upload_pbo(&monitor);
+        monitor.upload_us += perf_get_us() - start;
+#endif
+        monitor_sdl_gles_refr(NULL);
     }
-    glBindTexture(GL_TEXTURE_2D, monitor.texture);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SDL_HOR_RES, SDL_VER_RES, GL_RGB, GL_UNSIGNED_BYTE, monitor.texture_pixels);
-    monitor.sdl_refr_qry = true;
-    monitor_sdl_gles_refr(NULL);
     lv_disp_flush_ready(disp_drv);
 #else
     lv_coord_t hres = disp_drv->hor_res;
@@ -234,6 +368,52 @@ void sdl_gles_mouse_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data)
 
 }
 
+/**
+ * Read back the last presented frame, e.g. to verify the rendering in headless mode.
+ * @param rgba store the window sized RGBA pixels here, bottom row first.
+ *             The window is (SDL_HOR_RES * SDL_ZOOM) x (SDL_VER_RES * SDL_ZOOM), swapped if rotated by 90 or 270 degrees.
+ */
+void sdl_gles_read_pixels(uint8_t * rgba)
+{
+    /*The window's back buffer is undefined after swapping, so without an FBO it's only the best effort*/
+    glBindFramebuffer(GL_FRAMEBUFFER, monitor.present_fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, WINDOW_HOR_RES, WINDOW_VER_RES, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * Set a color correction table applied by the GPU when presenting.
+ * @param r 256 entries mapping the red channel, or NULL to disable the correction
+ * @param g 256 entries mapping the green channel
+ * @param b 256 entries mapping the blue channel
+ */
+void sdl_gles_set_gamma_lut(const uint8_t * r, const uint8_t * g, const uint8_t * b)
+{
+    glUseProgram(monitor.program);
+
+    if(r == NULL) {
+        glUniform1f(monitor.lut_enabled_location, 0.0f);
+    }
+    else {
+        GLubyte lut[256 * 4];
+        int i;
+        for(i = 0; i < 256; i++) {
+            lut[i * 4 + 0] = r[i];
+            lut[i * 4 + 1] = g[i];
+            lut[i * 4 + 2] = b[i];
+            lut[i * 4 + 3] = 0xff;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, monitor.lut_texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE, lut);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glUniform1f(monitor.lut_enabled_location, 1.0f);
+    }
+
+    monitor.sdl_refr_qry = true;
+}
+
 void sdl_gles_keyboard_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data)
 {
     (void) indev_drv;      /*Unused*/
@@ -297,13 +477,21 @@ static void sdl_gles_event_handler(lv_timer_t * t)
 
 static void window_create(monitor_t *m)
 {
+#if SDL_GLES_HEADLESS
+    if(!egl_create(m)) {
+        /*Every later step needs a current GL context*/
+        LV_LOG_ERROR("can't create a headless EGL context");
+        exit(EXIT_FAILURE);
+    }
+#else
     m->window = SDL_CreateWindow("lvgl-opengl",
                               SDL_WINDOWPOS_UNDEFINED,
                               SDL_WINDOWPOS_UNDEFINED,
-                              SDL_HOR_RES * SDL_ZOOM, SDL_VER_RES * SDL_ZOOM,
+                              WINDOW_HOR_RES, WINDOW_VER_RES,
                               SDL_WINDOW_SHOWN | SDL_WINDOW_OPENGL);
 
     m->context = SDL_GL_CreateContext(m->window);
+#endif
 
 
     printf( "GL version : %s\n", glGetString(GL_VERSION));
@@ -316,17 +504,81 @@ static void window_create(monitor_t *m)
     glUseProgram(m->program);
     m->position_location = glGetAttribLocation(m->program, "a_position");
     m->uv_location = glGetAttribLocation(m->program, "a_texcoord");
+    m->lut_enabled_location = glGetUniformLocation(m->program, "u_lut_enabled");
+    glUniform1i(glGetUniformLocation(m->program, "s_texture"), 0);
+    glUniform1i(glGetUniformLocation(m->program, "s_lut"), 1);
+    glUniform1f(m->lut_enabled_location, 0.0f);
+
+    /*Rows of the matrix rotating the texture coordinates clockwise.
+     *In SW mixed mode the texture's first row is the top of the display, else the bottom,
+     *so the rotation direction in texture space is mirrored.*/
+#if SDL_GLES_ROTATION == 90
+    GLfloat rot[2][2] = {{0.0f, 1.0f}, {-1.0f, 0.0f}};
+#elif SDL_GLES_ROTATION == 180
+    GLfloat rot[2][2] = {{-1.0f, 0.0f}, {0.0f, -1.0f}};
+#elif SDL_GLES_ROTATION == 270
+    GLfloat rot[2][2] = {{0.0f, -1.0f}, {1.0f, 0.0f}};
+#else
+    GLfloat rot[2][2] = {{1.0f, 0.0f}, {0.0f, 1.0f}};
+#endif
+#if LV_USE_GPU_GLES_SW_MIXED
+    /*GLSL matrices are column major*/
+    GLfloat uv_rot[4] = {rot[0][0], rot[1][0], rot[0][1], rot[1][1]};
+#else
+    GLfloat uv_rot[4] = {rot[0][0], rot[0][1], rot[1][0], rot[1][1]};
+#endif
+    glUniformMatrix2fv(glGetUniformLocation(m->program, "u_uv_rot"), 1, GL_FALSE, uv_rot);
+
+    glGenBuffers(1, &m->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenTextures(1, &m->lut_texture);
+    glBindTexture(GL_TEXTURE_2D, m->lut_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    /*Repeat the pixels for the integer zoom unless filtering is requested*/
+#if SDL_GLES_LINEAR_FILTER
+    GLint filter = GL_LINEAR;
+#else
+    GLint filter = GL_NEAREST;
+#endif
 
     glGenTextures(1, &m->texture);
     glBindTexture(GL_TEXTURE_2D, m->texture);
-    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter );
+    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter );
     glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
     glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 
 #if LV_USE_GPU_GLES_SW_MIXED
     m->texture_pixels = malloc(SDL_HOR_RES * SDL_VER_RES * BYTES_PER_PIXEL * sizeof(GLubyte));
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SDL_HOR_RES, SDL_VER_RES, 0, GL_RGB, GL_UNSIGNED_BYTE, m->texture_pixels);
+    m->pixels = m->texture_pixels;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SDL_HOR_RES, SDL_VER_RES, 0, GL_RGB, TEXTURE_TYPE, m->texture_pixels);
+
+    /*Rows of the uploaded areas are tightly packed and can be sub-rows of the texture with GLES3 or GL_EXT_unpack_subimage*/
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    m->unpack_row_length = epoxy_is_desktop_gl() || epoxy_gl_version() >= 30 ||
+                           epoxy_has_gl_extension("GL_EXT_unpack_subimage");
+
+#if SDL_GLES_PBO
+    /*glMapBufferRange is needed, GLES2 keeps uploading from the client memory*/
+    m->pbo_enabled = epoxy_gl_version() >= 30;
+    if(m->pbo_enabled) {
+        int i;
+        glGenBuffers(2, m->pbo);
+        for(i = 0; i < 2; i++) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m->pbo[i]);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, SDL_HOR_RES * SDL_VER_RES * BYTES_PER_PIXEL, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+#endif
 #else
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SDL_HOR_RES, SDL_VER_RES, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     glGenFramebuffers(1, &m->framebuffer);
@@ -335,6 +587,17 @@ static void window_create(monitor_t *m)
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 #endif /* LV_USE_GPU_GLES_SW_MIXED */
 
+#if SDL_GLES_HEADLESS
+    /*There is no window to present to, present into a texture instead*/
+    glGenTextures(1, &m->present_texture);
+    glBindTexture(GL_TEXTURE_2D, m->present_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, WINDOW_HOR_RES, WINDOW_VER_RES, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glGenFramebuffers(1, &m->present_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m->present_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m->present_texture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+#endif
+
     glBindTexture(GL_TEXTURE_2D, 0);
     m->sdl_refr_qry = true;
 
@@ -355,24 +618,121 @@ static void monitor_sdl_gles_refr(lv_timer_t *t)
 
 static void window_update(monitor_t *m)
 {
+    uint32_t start = perf_get_us();
 
+    glBindFramebuffer(GL_FRAMEBUFFER, m->present_fbo);
+    glViewport(0, 0, WINDOW_HOR_RES, WINDOW_VER_RES);
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
 
+    /*Rotation, scaling and color correction are done in one pass by the shaders*/
     glUseProgram(m->program);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m->lut_texture);
+    glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, m->texture);
 
-    glVertexAttribPointer(m->position_location, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, m->vbo);
+    glVertexAttribPointer(m->position_location, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (const void *)0);
     glEnableVertexAttribArray(m->position_location);
-    glVertexAttribPointer(m->uv_location, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), &vertices[2]);
+    glVertexAttribPointer(m->uv_location, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (const void *)(2 * sizeof(float)));
     glEnableVertexAttribArray(m->uv_location);
     glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+    uint32_t draw_end = perf_get_us();
+    m->draw_us += draw_end - start;
 
+#if SDL_GLES_HEADLESS
+    /*Wait for the GPU to have comparable timing with a real swap*/
+    if(m->egl_surface != EGL_NO_SURFACE) eglSwapBuffers(m->egl_display, m->egl_surface);
+    glFinish();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+#else
     SDL_GL_SwapWindow(m->window);
+#endif
+
+    m->swap_us += perf_get_us() - draw_end;
+    m->frame_cnt++;
+}
+
+/**
+ * Get a microsecond timestamp for the timing statistics
+ * @return microseconds from an arbitrary point, wraps around
+ */
+static uint32_t perf_get_us(void)
+{
+    uint64_t cnt = SDL_GetPerformanceCounter();
+    uint64_t freq = SDL_GetPerformanceFrequency();
+
+    return (uint32_t)((cnt / freq) * 1000000 + (cnt % freq) * 1000000 / freq);
+}
 
+#if SDL_GLES_HEADLESS
+/**
+ * Create an EGL context without window. A surfaceless context is used if possible
+ * (e.g. Mesa's surfaceless platform), else a small pbuffer surface.
+ * @param m pointer to the monitor
+ * @return true on success
+ */
+static bool egl_create(monitor_t * m)
+{
+    m->egl_display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if(epoxy_has_egl_extension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+        m->egl_display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+#endif
+    if(m->egl_display == EGL_NO_DISPLAY) m->egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(m->egl_display == EGL_NO_DISPLAY || !eglInitialize(m->egl_display, NULL, NULL)) return false;
+
+    eglBindAPI(EGL_OPENGL_ES_API);
+
+    bool surfaceless = epoxy_has_egl_extension(m->egl_display, "EGL_KHR_surfaceless_context");
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint config_cnt;
+    if(!eglChooseConfig(m->egl_display, config_attribs, &config, 1, &config_cnt) || config_cnt < 1) return false;
+
+    static const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+    m->egl_context = eglCreateContext(m->egl_display, config, EGL_NO_CONTEXT, context_attribs);
+    if(m->egl_context == EGL_NO_CONTEXT) return false;
+
+    m->egl_surface = EGL_NO_SURFACE;
+    if(!surfaceless) {
+        /*Only to make the context current, the frames are presented into an FBO*/
+        static const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        m->egl_surface = eglCreatePbufferSurface(m->egl_display, config, pbuffer_attribs);
+        if(m->egl_surface == EGL_NO_SURFACE) return false;
+    }
+
+    return eglMakeCurrent(m->egl_display, m->egl_surface, m->egl_surface, m->egl_context);
+}
+
+/**
+ * Print the average time of the steps of a frame. Called at exit.
+ */
+static void headless_report(void)
+{
+    monitor_t * m = &monitor;
+    if(m->frame_cnt == 0) return;
+
+    printf("sdl_gles: %u frames, average upload: %u us, draw: %u us, swap: %u us\n",
+           (unsigned int)m->frame_cnt,
+           (unsigned int)(m->upload_us / m->frame_cnt),
+           (unsigned int)(m->draw_us / m->frame_cnt),
+           (unsigned int)(m->swap_us / m->frame_cnt));
 }
+#endif /* SDL_GLES_HEADLESS */
 
 static void mouse_handler(SDL_Event *event)
 {
@@ -384,32 +744,53 @@ static void mouse_handler(SDL_Event *event)
         case SDL_MOUSEBUTTONDOWN:
             if(event->button.button == SDL_BUTTON_LEFT) {
                 left_button_down = true;
-                last_x = event->motion.x / SDL_ZOOM;
-                last_y = event->motion.y / SDL_ZOOM;
+                window_to_disp(event->button.x, event->button.y);
             }
             break;
         case SDL_MOUSEMOTION:
-            last_x = event->motion.x / SDL_ZOOM;
-            last_y = event->motion.y / SDL_ZOOM;
+            window_to_disp(event->motion.x, event->motion.y);
             break;
 
+        /*Finger coordinates are normalized to the window*/
         case SDL_FINGERUP:
             left_button_down = false;
-            last_x = LV_HOR_RES * event->tfinger.x / SDL_ZOOM;
-            last_y = LV_VER_RES * event->tfinger.y / SDL_ZOOM;
+            window_to_disp(WINDOW_HOR_RES * event->tfinger.x, WINDOW_VER_RES * event->tfinger.y);
             break;
         case SDL_FINGERDOWN:
             left_button_down = true;
-            last_x = LV_HOR_RES * event->tfinger.x / SDL_ZOOM;
-            last_y = LV_VER_RES * event->tfinger.y / SDL_ZOOM;
+            window_to_disp(WINDOW_HOR_RES * event->tfinger.x, WINDOW_VER_RES * event->tfinger.y);
             break;
         case SDL_FINGERMOTION:
-            last_x = LV_HOR_RES * event->tfinger.x / SDL_ZOOM;
-            last_y = LV_VER_RES * event->tfinger.y / SDL_ZOOM;
+            window_to_disp(WINDOW_HOR_RES * event->tfinger.x, WINDOW_VER_RES * event->tfinger.y);
             break;
     }
 }
 
+/**
+ * Convert a window coordinate to the display's, considering the zoom and rotation, and store it as the last position
+ * @param wx x coordinate in the window
+ * @param wy y coordinate in the window
+ */
+static void window_to_disp(int32_t wx, int32_t wy)
+{
+    wx /= SDL_ZOOM;
+    wy /= SDL_ZOOM;
+
+#if SDL_GLES_ROTATION == 90
+    last_x = wy;
+    last_y = SDL_VER_RES - 1 - wx;
+#elif SDL_GLES_ROTATION == 180
+    last_x = SDL_HOR_RES - 1 - wx;
+    last_y = SDL_VER_RES - 1 - wy;
+#elif SDL_GLES_ROTATION == 270
+    last_x = SDL_HOR_RES - 1 - wy;
+    last_y = wx;
+#else
+    last_x = wx;
+    last_y = wy;
+#endif
+}
+
 static void keyboard_handler(SDL_Event * event)
 {
     /* We only care about SDL_KEYDOWN and SDL_TEXTINPUT events */
@@ -487,7 +868,14 @@ static uint32_t keycode_to_ctrl_key(SDL_Keycode sdl_key)
 
 static void monitor_sdl_gles_clean_up(void)
 {
+#if SDL_GLES_HEADLESS
+    eglMakeCurrent(monitor.egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if(monitor.egl_surface != EGL_NO_SURFACE) eglDestroySurface(monitor.egl_display, monitor.egl_surface);
+    eglDestroyContext(monitor.egl_display, monitor.egl_context);
+    eglTerminate(monitor.egl_display);
+#else
     SDL_DestroyWindow(monitor.window);
+#endif
 }
 
 static int tick_thread(void *data)
@@ -503,17 +891,155 @@ static int tick_thread(void *data)
 }
 
 #if LV_USE_GPU_GLES_SW_MIXED
-#include <assert.h>
-// From the article https://lupyuen.github.io/pinetime-rust-mynewt/articles/wayland
-static void put_px(uint16_t x, uint16_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+/**
+ * Convert a row of pixels to the texture's format (RGB565 or RGB)
+ * @param dst destination in `texture_pixels`
+ * @param src source pixels
+ * @param len number of pixels
+ */
+static void convert_row(GLubyte * dst, const lv_color_t * src, int32_t len)
 {
-    assert(x >= 0); assert(x < SDL_HOR_RES);
-    assert(y >= 0); assert(y < SDL_VER_RES);
-    int i = (y * SDL_HOR_RES * BYTES_PER_PIXEL) + (x * BYTES_PER_PIXEL);
-    monitor.texture_pixels[i++] = r;  //  Red
-    monitor.texture_pixels[i++] = g;  //  Green
-    monitor.texture_pixels[i++] = b;  //  Blue
+    /*Simple enough loops for the compiler to vectorize*/
+    int32_t i;
+#if LV_COLOR_DEPTH == 16 && LV_COLOR_16_SWAP
+    uint16_t * d = (uint16_t *)dst;
+    const uint16_t * s = (const uint16_t *)src;
+    for(i = 0; i < len; i++) {
+        d[i] = (uint16_t)((s[i] >> 8) | (s[i] << 8));
+    }
+#elif LV_COLOR_DEPTH == 16
+    LV_UNUSED(i);
+    memcpy(dst, src, len * sizeof(lv_color_t));
+#elif LV_COLOR_DEPTH == 32
+    for(i = 0; i < len; i++) {
+        dst[i * 3 + 0] = src[i].ch.red;
+        dst[i * 3 + 1] = src[i].ch.green;
+        dst[i * 3 + 2] = src[i].ch.blue;
+    }
+#else
+    for(i = 0; i < len; i++) {
+        lv_color32_t c;
+        c.full = lv_color_to32(src[i]);
+        dst[i * 3 + 0] = c.ch.red;
+        dst[i * 3 + 1] = c.ch.green;
+        dst[i * 3 + 2] = c.ch.blue;
+    }
+#endif
+}
+
+/**
+ * Upload an area of the current pixels to the texture
+ * @param m pointer to the monitor
+ * @param area the area to upload, must be on the screen
+ */
+static void texture_upload(monitor_t * m, const lv_area_t * area)
+{
+    int32_t w = lv_area_get_width(area);
+    int32_t h = lv_area_get_height(area);
+
+    glBindTexture(GL_TEXTURE_2D, m->texture);
+    if(m->unpack_row_length) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, SDL_HOR_RES);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, area->x1, area->y1, w, h, GL_RGB, TEXTURE_TYPE,
+                        m->pixels + (area->y1 * SDL_HOR_RES + area->x1) * BYTES_PER_PIXEL);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+    else {
+        /*Without row length only whole rows can be uploaded*/
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, area->y1, SDL_HOR_RES, h, GL_RGB, TEXTURE_TYPE,
+                        m->pixels + area->y1 * SDL_HOR_RES * BYTES_PER_PIXEL);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+#if SDL_GLES_PBO
+/**
+ * Remember a flushed area to upload it at the end of the frame
+ * @param m pointer to the monitor
+ * @param area the flushed area, must be on the screen
+ */
+static void monitor_add_dirty(monitor_t * m, const lv_area_t * area)
+{
+    uint32_t i;
+
+    if(m->dirty_cnt < SDL_DIRTY_AREA_MAX) {
+        m->dirty[m->dirty_cnt] = *area;
+        m->dirty_cnt++;
+        return;
+    }
+
+    /*Too many areas: merge everything into one bounding box. The screen sized buffer has all of it.*/
+    lv_area_t * d = &m->dirty[0];
+    for(i = 0; i < m->dirty_cnt; i++) {
+        d->x1 = LV_MIN(d->x1, m->dirty[i].x1);
+        d->y1 = LV_MIN(d->y1, m->dirty[i].y1);
+        d->x2 = LV_MAX(d->x2, m->dirty[i].x2);
+        d->y2 = LV_MAX(d->y2, m->dirty[i].y2);
+    }
+    d->x1 = LV_MIN(d->x1, area->x1);
+    d->y1 = LV_MIN(d->y1, area->y1);
+    d->x2 = LV_MAX(d->x2, area->x2);
+    d->y2 = LV_MAX(d->y2, area->y2);
+    m->dirty_cnt = 1;
+}
+
+/**
+ * Upload the areas flushed in this frame through the next PBO.
+ * The GPU copies from the PBO asynchronously, while the other PBO is filled for the next frame.
+ * @param m pointer to the monitor
+ */
+static void texture_upload_pbo(monitor_t * m)
+{
+    uint32_t i;
+    size_t size = 0;
+
+    if(m->dirty_cnt == 0) return;
+
+    for(i = 0; i < m->dirty_cnt; i++) {
+        size += (size_t)lv_area_get_size(&m->dirty[i]) * BYTES_PER_PIXEL;
+    }
+
+    /*Invalidate the buffer to not wait for the GPU if it's still reading it*/
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m->pbo[m->pbo_act]);
+    GLubyte * dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if(dst == NULL) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        for(i = 0; i < m->dirty_cnt; i++) {
+            texture_upload(m, &m->dirty[i]);
+        }
+        m->dirty_cnt = 0;
+        return;
+    }
+
+    /*Pack the rows of the areas one after the other*/
+    GLubyte * p = dst;
+    for(i = 0; i < m->dirty_cnt; i++) {
+        const lv_area_t * a = &m->dirty[i];
+        size_t row_size = lv_area_get_width(a) * BYTES_PER_PIXEL;
+        int32_t y;
+        for(y = a->y1; y <= a->y2; y++) {
+            memcpy(p, m->pixels + (y * SDL_HOR_RES + a->x1) * BYTES_PER_PIXEL, row_size);
+            p += row_size;
+        }
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    /*The pointers are offsets in the bound PBO*/
+    size_t offset = 0;
+    glBindTexture(GL_TEXTURE_2D, m->texture);
+    for(i = 0; i < m->dirty_cnt; i++) {
+        const lv_area_t * a = &m->dirty[i];
+        glTexSubImage2D(GL_TEXTURE_2D, 0, a->x1, a->y1, lv_area_get_width(a), lv_area_get_height(a),
+                        GL_RGB, TEXTURE_TYPE, (const void *)(uintptr_t)offset);
+        offset += (size_t)lv_area_get_size(a) * BYTES_PER_PIXEL;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    m->pbo_act ^= 1;
+    m->dirty_cnt = 0;
 }
+#endif /* SDL_GLES_PBO */
 #endif /* LV_USE_GPU_GLES_SW_MIXED */
 
 static GLuint shader_create(GLenum type, const char *src)
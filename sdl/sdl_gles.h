@@ -54,6 +54,21 @@ void sdl_gles_mouse_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data);
 
 void sdl_gles_keyboard_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data);
 
+/**
+ * Read back the last presented frame, e.g. to verify the rendering in headless mode.
+ * @param rgba store the window sized RGBA pixels here, bottom row first.
+ *             The window is (SDL_HOR_RES * SDL_ZOOM) x (SDL_VER_RES * SDL_ZOOM), swapped if rotated by 90 or 270 degrees.
+ */
+void sdl_gles_read_pixels(uint8_t * rgba);
+
+/**
+ * Set a color correction table applied by the GPU when presenting.
+ * @param r 256 entries mapping the red channel, or NULL to disable the correction
+ * @param g 256 entries mapping the green channel
+ * @param b 256 entries mapping the blue channel
+ */
+void sdl_gles_set_gamma_lut(const uint8_t * r, const uint8_t * g, const uint8_t * b);
+
 /**********************
  *      MACROS
  **********************/
@@ -29,6 +29,10 @@
 # error "Cannot enable both MONITOR and SDL at the same time. "
 #endif
 
+#ifndef SDL_PARTIAL_PRESENT
+# define SDL_PARTIAL_PRESENT   0
+#endif
+
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
@@ -41,26 +45,61 @@
 #define KEYBOARD_BUFFER_SIZE SDL_TEXTINPUTEVENT_TEXT_SIZE
 #endif
 
+/*Number of drawn areas remembered per frame. More areas are merged into their bounding box*/
+#ifndef SDL_DIRTY_AREA_MAX
+#define SDL_DIRTY_AREA_MAX 16
+#endif
+
+/*The textures are allocated in steps of this size to not reallocate them on every resize event*/
+#ifndef SDL_TEXTURE_SIZE_STEP
+#define SDL_TEXTURE_SIZE_STEP 128
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
-typedef struct {
+typedef struct _sdl_window_t {
     SDL_Window * window;
     SDL_Renderer * renderer;
     SDL_Texture * texture;
+    Uint32 window_id;
+    lv_coord_t hor_res;
+    lv_coord_t ver_res;
+    int zoom;
+    int tex_w;                  /*Allocated size of the texture, can be larger than the resolution*/
+    int tex_h;
+    struct _sdl_window_t * next;
     volatile bool sdl_refr_qry;
+    bool full_present;          /*The whole texture has to be copied to the window*/
+    SDL_Rect dirty[SDL_DIRTY_AREA_MAX];     /*Areas drawn since the last present*/
+    uint32_t dirty_cnt;
+    uint32_t present_period;    /*Minimal time between two presents [ms], 0: paced by vsync*/
+    uint32_t last_present;
+    bool left_button_down;      /*State of the pointer in this window*/
+    int16_t last_x;
+    int16_t last_y;
 }monitor_t;
 
 /**********************
  *  STATIC PROTOTYPES
  **********************/
-static void window_create(monitor_t * m);
+static void sdl_common_init(void);
+static void window_create(monitor_t * m, lv_coord_t hor_res, lv_coord_t ver_res, int zoom);
+static void window_destroy(monitor_t * m);
+static bool window_texture_alloc(monitor_t * m, int w, int h);
+static monitor_t * monitor_from_renderer(SDL_Renderer * renderer);
+static monitor_t * monitor_from_id(Uint32 window_id);
+static monitor_t * monitor_from_disp(lv_disp_t * disp);
+static void window_flush(monitor_t * m, lv_disp_drv_t * disp_drv, const lv_area_t * area);
 static void window_update(monitor_t * m);
+static void monitor_add_dirty(monitor_t * m, const lv_area_t * area);
+static bool monitor_present_due(monitor_t * m);
 int quit_filter(void * userdata, SDL_Event * event);
 static void monitor_sdl_clean_up(void);
 static void sdl_event_handler(lv_timer_t * t);
 static void monitor_sdl_refr(lv_timer_t * t);
 static void mouse_handler(SDL_Event * event);
+static void mouse_move(monitor_t * m, int x, int y);
 static void mousewheel_handler(SDL_Event * event);
 static uint32_t keycode_to_ctrl_key(SDL_Keycode sdl_key);
 static void keyboard_handler(SDL_Event * event);
@@ -79,11 +118,10 @@ monitor_t monitor;
 monitor_t monitor2;
 #endif
 
-static volatile bool sdl_quit_qry = false;
+static monitor_t * monitor_list;    /*All windows, linked through `next`*/
+static bool sdl_inited = false;
 
-static bool left_button_down = false;
-static int16_t last_x = 0;
-static int16_t last_y = 0;
+static volatile bool sdl_quit_qry = false;
 
 static int16_t wheel_diff = 0;
 static lv_indev_state_t wheel_state = LV_INDEV_STATE_RELEASED;
@@ -100,39 +138,84 @@ static char buf[KEYBOARD_BUFFER_SIZE];
 
 void sdl_init(void)
 {
-    /*Initialize the SDL*/
-    SDL_Init(SDL_INIT_VIDEO);
-
-    SDL_SetEventFilter(quit_filter, NULL);
+    sdl_common_init();
 
-    window_create(&monitor);
+    window_create(&monitor, SDL_HOR_RES, SDL_VER_RES, SDL_ZOOM);
 #if SDL_DUAL_DISPLAY
-    window_create(&monitor2);
+    window_create(&monitor2, SDL_HOR_RES, SDL_VER_RES, SDL_ZOOM);
     int x, y;
     SDL_GetWindowPosition(monitor2.window, &x, &y);
     SDL_SetWindowPosition(monitor.window, x + (SDL_HOR_RES * SDL_ZOOM) / 2 + 10, y);
     SDL_SetWindowPosition(monitor2.window, x - (SDL_HOR_RES * SDL_ZOOM) / 2 - 10, y);
 #endif
+}
 
-    SDL_StartTextInput();
+/**
+ * Open a new accelerated window with its own renderer and texture.
+ * @param hor_res horizontal resolution of the simulated display
+ * @param ver_res vertical resolution of the simulated display
+ * @param zoom scale the window by this factor
+ * @return the window's context or NULL on error
+ */
+sdl_window_t * sdl_window_create(lv_coord_t hor_res, lv_coord_t ver_res, int zoom)
+{
+    sdl_common_init();
 
-    /* Tick init.
-     * You have to call 'lv_tick_inc()' in periodically to inform LittelvGL about
-     * how much time were elapsed Create an SDL thread to do this*/
-    SDL_CreateThread(tick_thread, "tick", NULL);
+    monitor_t * m = calloc(1, sizeof(monitor_t));
+    if(m == NULL) return NULL;
 
-    lv_timer_create(sdl_event_handler, 10, NULL);
+    window_create(m, hor_res, ver_res, zoom < 1 ? 1 : zoom);
+    if(m->window == NULL || m->renderer == NULL || m->texture == NULL) {
+        window_destroy(m);
+        free(m);
+        return NULL;
+    }
+
+    return m;
+}
+
+/**
+ * Close a window created by `sdl_window_create()`.
+ * @param win the window's context
+ */
+void sdl_window_delete(sdl_window_t * win)
+{
+    window_destroy(win);
+    free(win);
 }
 
 void sdl_gpu_disp_draw_buf_init(lv_disp_draw_buf_t *draw_buf)
 {
-    lv_disp_draw_buf_init(draw_buf, monitor.texture, NULL, SDL_HOR_RES * SDL_VER_RES);
+    sdl_gpu_window_draw_buf_init(&monitor, draw_buf);
 }
 
 void sdl_gpu_disp_drv_init(lv_disp_drv_t *driver)
+{
+    sdl_gpu_window_drv_init(&monitor, driver);
+}
+
+/**
+ * Initialize a draw buffer with the texture of a window
+ * @param win the window's context
+ * @param draw_buf the draw buffer to initialize
+ */
+void sdl_gpu_window_draw_buf_init(sdl_window_t * win, lv_disp_draw_buf_t * draw_buf)
+{
+    lv_disp_draw_buf_init(draw_buf, win->texture, NULL, win->hor_res * win->ver_res);
+}
+
+/**
+ * Initialize a display driver to render with the renderer of a window
+ * @param win the window's context
+ * @param driver the display driver to initialize
+ */
+void sdl_gpu_window_drv_init(sdl_window_t * win, lv_disp_drv_t * driver)
 {
     lv_disp_drv_init(driver);
-    driver->user_data = monitor.renderer;
+    /*LVGL's SDL renderer needs the renderer here, the window is found by its renderer*/
+    driver->user_data = win->renderer;
+    driver->hor_res = win->hor_res;
+    driver->ver_res = win->ver_res;
 }
 
 /**
@@ -143,28 +226,12 @@ void sdl_gpu_disp_drv_init(lv_disp_drv_t *driver)
  */
 void sdl_display_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p)
 {
-    lv_coord_t hres = disp_drv->hor_res;
-    lv_coord_t vres = disp_drv->ver_res;
-
-//    printf("x1:%d,y1:%d,x2:%d,y2:%d\n", area->x1, area->y1, area->x2, area->y2);
-
-    /*Return if the area is out the screen*/
-    if(area->x2 < 0 || area->y2 < 0 || area->x1 > hres - 1 || area->y1 > vres - 1) {
-        lv_disp_flush_ready(disp_drv);
-        return;
-    }
-
-    monitor.sdl_refr_qry = true;
-
-    /* TYPICALLY YOU DO NOT NEED THIS
-     * If it was the last part to refresh update the texture of the window.*/
-    if(lv_disp_flush_is_last(disp_drv)) {
-        monitor_sdl_refr(NULL);
-    }
+    LV_UNUSED(color_p);     /*The area is already rendered into the texture*/
 
-    /*IMPORTANT! It must be called to tell the system the flush is ready*/
-    lv_disp_flush_ready(disp_drv);
+    monitor_t * m = monitor_from_renderer(disp_drv->user_data);
+    if(m == NULL) m = &monitor;
 
+    window_flush(m, disp_drv, area);
 }
 
 
@@ -178,45 +245,31 @@ void sdl_display_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_colo
  */
 void sdl_display_flush2(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p)
 {
-    lv_coord_t hres = disp_drv->hor_res;
-    lv_coord_t vres = disp_drv->ver_res;
-
-    /*Return if the area is out the screen*/
-    if(area->x2 < 0 || area->y2 < 0 || area->x1 > hres - 1 || area->y1 > vres - 1) {
-        lv_disp_flush_ready(disp_drv);
-        return;
-    }
-
-    monitor2.sdl_refr_qry = true;
+    LV_UNUSED(color_p);     /*The area is already rendered into the texture*/
 
-    /* TYPICALLY YOU DO NOT NEED THIS
-     * If it was the last part to refresh update the texture of the window.*/
-    if(lv_disp_flush_is_last(disp_drv)) {
-        monitor_sdl_refr(NULL);
-    }
+    monitor_t * m = monitor_from_renderer(disp_drv->user_data);
+    if(m == NULL) m = &monitor2;
 
-    /*IMPORTANT! It must be called to tell the system the flush is ready*/
-    lv_disp_flush_ready(disp_drv);
+    window_flush(m, disp_drv, area);
 }
 #endif
 
 void sdl_display_resize(lv_disp_t *disp, int width, int height)
 {
     lv_disp_drv_t *driver = disp->driver;
-    SDL_Renderer *renderer = driver->user_data;
-    if (driver->draw_buf->buf1) {
-        SDL_DestroyTexture(driver->draw_buf->buf1);
-    }
-    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width,
-                                             height);
-    monitor.texture = texture;
-    lv_disp_draw_buf_init(driver->draw_buf, texture, NULL, width * height);
+    monitor_t * m = monitor_from_renderer(driver->user_data);
+    if(m == NULL) return;
+
+    if(!window_texture_alloc(m, width, height)) return;
+
+    m->hor_res = width;
+    m->ver_res = height;
+    m->dirty_cnt = 0;
+    m->full_present = true;
+    lv_disp_draw_buf_init(driver->draw_buf, m->texture, NULL, width * height);
     driver->hor_res = (lv_coord_t) width;
     driver->ver_res = (lv_coord_t) height;
-    SDL_RendererInfo renderer_info;
-    SDL_GetRendererInfo(renderer, &renderer_info);
-    SDL_assert(renderer_info.flags & SDL_RENDERER_TARGETTEXTURE);
-    SDL_SetRenderTarget(renderer, texture);
+    SDL_SetRenderTarget(m->renderer, m->texture);
     lv_disp_drv_update(disp, driver);
 }
 
@@ -227,12 +280,13 @@ void sdl_display_resize(lv_disp_t *disp, int width, int height)
  */
 void sdl_mouse_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data)
 {
-    (void) indev_drv;      /*Unused*/
+    /*Read the window of the display the mouse belongs to*/
+    monitor_t * m = monitor_from_disp(indev_drv->disp ? indev_drv->disp : lv_disp_get_default());
 
     /*Store the collected data*/
-    data->point.x = last_x;
-    data->point.y = last_y;
-    data->state = left_button_down ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    data->point.x = m->last_x;
+    data->point.y = m->last_y;
+    data->state = m->left_button_down ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
 }
 
 
@@ -282,6 +336,105 @@ void sdl_keyboard_read(lv_indev_drv_t * indev_drv, lv_indev_data_t * data)
  *   STATIC FUNCTIONS
  **********************/
 
+/**
+ * Initialize SDL, the input handling and the tick once, no matter how many windows are created.
+ */
+static void sdl_common_init(void)
+{
+    if(sdl_inited) return;
+    sdl_inited = true;
+
+    /*Initialize the SDL*/
+    SDL_Init(SDL_INIT_VIDEO);
+
+    SDL_SetEventFilter(quit_filter, NULL);
+
+    SDL_StartTextInput();
+
+    /* Tick init.
+     * You have to call 'lv_tick_inc()' in periodically to inform LittelvGL about
+     * how much time were elapsed Create an SDL thread to do this*/
+    SDL_CreateThread(tick_thread, "tick", NULL);
+
+    lv_timer_create(sdl_event_handler, 10, NULL);
+}
+
+/**
+ * Mark a rendered area of a window to be presented
+ * @param m pointer to the window
+ * @param disp_drv pointer to driver where this function belongs
+ * @param area the area rendered into the window's texture
+ */
+static void window_flush(monitor_t * m, lv_disp_drv_t * disp_drv, const lv_area_t * area)
+{
+    lv_coord_t hres = disp_drv->hor_res;
+    lv_coord_t vres = disp_drv->ver_res;
+
+    /*Return if the area is out the screen*/
+    if(area->x2 < 0 || area->y2 < 0 || area->x1 > hres - 1 || area->y1 > vres - 1) {
+        lv_disp_flush_ready(disp_drv);
+        return;
+    }
+
+    monitor_add_dirty(m, area);
+    m->sdl_refr_qry = true;
+
+    /* TYPICALLY YOU DO NOT NEED THIS
+     * If it was the last part to refresh update the texture of the window.*/
+    if(lv_disp_flush_is_last(disp_drv)) {
+        monitor_sdl_refr(NULL);
+    }
+
+    /*IMPORTANT! It must be called to tell the system the flush is ready*/
+    lv_disp_flush_ready(disp_drv);
+}
+
+/**
+ * Find the window using a renderer
+ * @param renderer an SDL renderer
+ * @return the window or NULL if it's not one of ours
+ */
+static monitor_t * monitor_from_renderer(SDL_Renderer * renderer)
+{
+    monitor_t * m;
+    for(m = monitor_list; m; m = m->next) {
+        if(m->renderer == renderer) return m;
+    }
+
+    return NULL;
+}
+
+/**
+ * Find the window an SDL event belongs to
+ * @param window_id ID of the SDL window
+ * @return the window or NULL if it's not one of ours
+ */
+static monitor_t * monitor_from_id(Uint32 window_id)
+{
+    monitor_t * m;
+    for(m = monitor_list; m; m = m->next) {
+        if(m->window_id == window_id) return m;
+    }
+
+    return NULL;
+}
+
+/**
+ * Find the window of a display
+ * @param disp pointer to a display or NULL
+ * @return the window, the first window if `disp` is NULL or isn't an SDL display
+ */
+static monitor_t * monitor_from_disp(lv_disp_t * disp)
+{
+    monitor_t * m = NULL;
+
+    if(disp) m = monitor_from_renderer(disp->driver->user_data);
+#if SDL_DUAL_DISPLAY
+    if(m == NULL && disp && disp->driver->flush_cb == sdl_display_flush2) return &monitor2;
+#endif
+    return m ? m : &monitor;
+}
+
 
 /**
  * SDL main thread. All SDL related task have to be handled here!
@@ -304,18 +457,24 @@ static void sdl_event_handler(lv_timer_t * t)
 #if SDL_VERSION_ATLEAST(2, 0, 5)
                 case SDL_WINDOWEVENT_TAKE_FOCUS:
 #endif
-                case SDL_WINDOWEVENT_EXPOSED:
-                    window_update(&monitor);
-#if SDL_DUAL_DISPLAY
-                    window_update(&monitor2);
-#endif
-                    break;
+                case SDL_WINDOWEVENT_EXPOSED: {
+                        /*Only mark it, a burst of expose events results in one present*/
+                        monitor_t * m = monitor_from_id(event.window.windowID);
+                        if(m) {
+                            m->sdl_refr_qry = true;
+                            m->full_present = true;
+                        }
+                        break;
+                    }
                 default:
                     break;
             }
         }
     }
 
+    /*Do the deferred presents*/
+    monitor_sdl_refr(NULL);
+
     /*Run until quit event not arrives*/
     if(sdl_quit_qry) {
         monitor_sdl_clean_up();
@@ -332,18 +491,27 @@ static void monitor_sdl_refr(lv_timer_t * t)
 {
     (void)t;
 
-    /*Refresh handling*/
-    if(monitor.sdl_refr_qry != false) {
-        monitor.sdl_refr_qry = false;
-        window_update(&monitor);
+    /*Refresh handling. Nothing is done (not even a render target switch) if nothing changed*/
+    monitor_t * m;
+    for(m = monitor_list; m; m = m->next) {
+        if(m->sdl_refr_qry != false && monitor_present_due(m)) {
+            m->sdl_refr_qry = false;
+            window_update(m);
+        }
     }
+}
 
-#if SDL_DUAL_DISPLAY
-    if(monitor2.sdl_refr_qry != false) {
-        monitor2.sdl_refr_qry = false;
-        window_update(&monitor2);
-    }
-#endif
+/**
+ * Check whether a display refresh elapsed since the last present.
+ * A deferred present is done by the next `sdl_event_handler` call.
+ * @param m pointer to the monitor
+ * @return true if the monitor can present again
+ */
+static bool monitor_present_due(monitor_t * m)
+{
+    if(m->present_period == 0) return true;
+
+    return SDL_GetTicks() - m->last_present >= m->present_period;
 }
 
 int quit_filter(void * userdata, SDL_Event * event)
@@ -364,93 +532,243 @@ int quit_filter(void * userdata, SDL_Event * event)
 
 static void monitor_sdl_clean_up(void)
 {
-    SDL_DestroyTexture(monitor.texture);
-    SDL_DestroyRenderer(monitor.renderer);
-    SDL_DestroyWindow(monitor.window);
-
-#if SDL_DUAL_DISPLAY
-    SDL_DestroyTexture(monitor2.texture);
-    SDL_DestroyRenderer(monitor2.renderer);
-    SDL_DestroyWindow(monitor2.window);
-
-#endif
+    while(monitor_list) {
+        window_destroy(monitor_list);
+    }
 
     SDL_Quit();
 }
 
-static void window_create(monitor_t * m)
+static void window_create(monitor_t * m, lv_coord_t hor_res, lv_coord_t ver_res, int zoom)
 {
     m->window = SDL_CreateWindow("TFT Simulator",
                               SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-                              SDL_HOR_RES * SDL_ZOOM, SDL_VER_RES * SDL_ZOOM, 0);       /*last param. SDL_WINDOW_BORDERLESS to hide borders*/
+                              hor_res * zoom, ver_res * zoom, 0);       /*last param. SDL_WINDOW_BORDERLESS to hide borders*/
+    m->window_id = SDL_GetWindowID(m->window);
+    m->zoom = zoom;
 
     m->renderer = SDL_CreateRenderer(m->window, -1, SDL_RENDERER_ACCELERATED);
-    m->texture = SDL_CreateTexture(m->renderer,
-                                SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, SDL_HOR_RES, SDL_VER_RES);
-    SDL_SetTextureBlendMode(m->texture, SDL_BLENDMODE_BLEND);
+    m->hor_res = hor_res;
+    m->ver_res = ver_res;
+    window_texture_alloc(m, hor_res, ver_res);
     /* For first frame */
     SDL_SetRenderTarget(m->renderer, m->texture);
 
+    m->next = monitor_list;
+    monitor_list = m;
+
+    /*Without vsync limit the presents to the refresh rate of the display*/
+    SDL_RendererInfo renderer_info;
+    SDL_DisplayMode mode;
+    m->present_period = 0;
+    if(SDL_GetRendererInfo(m->renderer, &renderer_info) != 0 || !(renderer_info.flags & SDL_RENDERER_PRESENTVSYNC)) {
+        if(SDL_GetWindowDisplayMode(m->window, &mode) == 0 && mode.refresh_rate > 0) {
+            m->present_period = 1000 / mode.refresh_rate;
+        }
+    }
+
     m->sdl_refr_qry = true;
+    m->full_present = true;
+}
+
+static void window_destroy(monitor_t * m)
+{
+    monitor_t ** p;
+    for(p = &monitor_list; *p; p = &(*p)->next) {
+        if(*p == m) {
+            *p = m->next;
+            break;
+        }
+    }
+
+    if(m->texture) SDL_DestroyTexture(m->texture);
+    if(m->renderer) SDL_DestroyRenderer(m->renderer);
+    if(m->window) SDL_DestroyWindow(m->window);
+    m->texture = NULL;
+    m->renderer = NULL;
+    m->window = NULL;
+}
+
+/**
+ * Make sure the texture of a window can hold the given resolution.
+ * The texture is allocated in SDL_TEXTURE_SIZE_STEP steps and reallocated only
+ * if it's too small or much larger than needed, so resizing doesn't churn textures.
+ * @param m pointer to the window
+ * @param w required width
+ * @param h required height
+ * @return true on success
+ */
+static bool window_texture_alloc(monitor_t * m, int w, int h)
+{
+    int tex_w = (w + SDL_TEXTURE_SIZE_STEP - 1) / SDL_TEXTURE_SIZE_STEP * SDL_TEXTURE_SIZE_STEP;
+    int tex_h = (h + SDL_TEXTURE_SIZE_STEP - 1) / SDL_TEXTURE_SIZE_STEP * SDL_TEXTURE_SIZE_STEP;
+
+    if(m->texture && tex_w <= m->tex_w && tex_h <= m->tex_h &&
+       tex_w * 2 > m->tex_w && tex_h * 2 > m->tex_h) {
+        return true;
+    }
+
+    SDL_Texture * texture = SDL_CreateTexture(m->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                              tex_w, tex_h);
+    if(texture == NULL) {
+        LV_LOG_ERROR("can't create %dx%d texture: %s", tex_w, tex_h, SDL_GetError());
+        return false;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    if(m->texture) SDL_DestroyTexture(m->texture);
+    m->texture = texture;
+    m->tex_w = tex_w;
+    m->tex_h = tex_h;
+
+    return true;
+}
+
+/**
+ * Remember a drawn area to copy only the changed parts of the texture to the window
+ * @param m pointer to the monitor
+ * @param area the drawn area
+ */
+static void monitor_add_dirty(monitor_t * m, const lv_area_t * area)
+{
+    SDL_Rect r;
+    uint32_t i;
+
+    if(m->full_present) return;
+
+    r.x = LV_MAX(area->x1, 0);
+    r.y = LV_MAX(area->y1, 0);
+    r.w = LV_MIN(area->x2, m->hor_res - 1) - r.x + 1;
+    r.h = LV_MIN(area->y2, m->ver_res - 1) - r.y + 1;
+    if(r.w <= 0 || r.h <= 0) return;
+
+    /*Skip areas which are already covered*/
+    for(i = 0; i < m->dirty_cnt; i++) {
+        const SDL_Rect * d = &m->dirty[i];
+        if(r.x >= d->x && r.y >= d->y && r.x + r.w <= d->x + d->w && r.y + r.h <= d->y + d->h) return;
+    }
 
+    if(m->dirty_cnt < SDL_DIRTY_AREA_MAX) {
+        m->dirty[m->dirty_cnt] = r;
+        m->dirty_cnt++;
+        return;
+    }
+
+    /*Too many areas: merge everything into one bounding box*/
+    for(i = 0; i < m->dirty_cnt; i++) {
+        SDL_UnionRect(&r, &m->dirty[i], &r);
+    }
+    m->dirty[0] = r;
+    m->dirty_cnt = 1;
 }
 
 static void window_update(monitor_t * m)
 {
     SDL_SetRenderTarget(m->renderer, NULL);
-    SDL_RenderClear(m->renderer);
+    SDL_RenderSetClipRect(m->renderer, NULL);
+
+#if SDL_PARTIAL_PRESENT
+    if(!m->full_present) {
+        /*The rest of the window is still there, replace only the changed areas*/
+        int out_w, out_h;
+        SDL_GetRendererOutputSize(m->renderer, &out_w, &out_h);
+        SDL_SetTextureBlendMode(m->texture, SDL_BLENDMODE_NONE);
+
+        uint32_t i;
+        for(i = 0; i < m->dirty_cnt; i++) {
+            const SDL_Rect * r = &m->dirty[i];
+            SDL_Rect dst;
+            dst.x = r->x * out_w / m->hor_res;
+            dst.y = r->y * out_h / m->ver_res;
+            dst.w = (r->x + r->w) * out_w / m->hor_res - dst.x;
+            dst.h = (r->y + r->h) * out_h / m->ver_res - dst.y;
+            SDL_RenderCopy(m->renderer, m->texture, r, &dst);
+        }
+    }
+    else
+#endif
+    {
+        SDL_RenderClear(m->renderer);
 #if LV_COLOR_SCREEN_TRANSP
-    SDL_SetRenderDrawColor(m->renderer, 0xff, 0, 0, 0xff);
-    SDL_Rect r;
-    r.x = 0; r.y = 0; r.w = SDL_HOR_RES; r.h = SDL_VER_RES;
-    SDL_RenderDrawRect(m->renderer, &r);
+        SDL_SetRenderDrawColor(m->renderer, 0xff, 0, 0, 0xff);
+        SDL_Rect r;
+        r.x = 0; r.y = 0; r.w = m->hor_res; r.h = m->ver_res;
+        SDL_RenderDrawRect(m->renderer, &r);
 #endif
 
-    /*Update the renderer with the texture containing the rendered image*/
-    SDL_SetTextureBlendMode(m->texture, SDL_BLENDMODE_BLEND);
-    SDL_RenderSetClipRect(m->renderer, NULL);
-    SDL_RenderCopy(m->renderer, m->texture, NULL, NULL);
+        /*Update the renderer with the texture containing the rendered image*/
+        SDL_Rect src;
+        src.x = 0; src.y = 0; src.w = m->hor_res; src.h = m->ver_res;
+        SDL_SetTextureBlendMode(m->texture, SDL_BLENDMODE_BLEND);
+        SDL_RenderCopy(m->renderer, m->texture, &src, NULL);
+    }
+
     SDL_RenderPresent(m->renderer);
     SDL_SetRenderTarget(m->renderer, m->texture);
+
+    m->last_present = SDL_GetTicks();
+    m->dirty_cnt = 0;
+    m->full_present = false;
 }
 
 static void mouse_handler(SDL_Event * event)
 {
+    monitor_t * m;
+
     switch(event->type) {
         case SDL_MOUSEBUTTONUP:
-            if(event->button.button == SDL_BUTTON_LEFT)
-                left_button_down = false;
-            break;
         case SDL_MOUSEBUTTONDOWN:
-            if(event->button.button == SDL_BUTTON_LEFT) {
-                left_button_down = true;
-                last_x = event->motion.x / SDL_ZOOM;
-                last_y = event->motion.y / SDL_ZOOM;
-            }
+            if(event->button.button != SDL_BUTTON_LEFT) break;
+            m = monitor_from_id(event->button.windowID);
+            if(m == NULL) break;
+            m->left_button_down = event->type == SDL_MOUSEBUTTONDOWN;
+            mouse_move(m, event->button.x, event->button.y);
             break;
         case SDL_MOUSEMOTION:
-            last_x = event->motion.x / SDL_ZOOM;
-            last_y = event->motion.y / SDL_ZOOM;
+            m = monitor_from_id(event->motion.windowID);
+            if(m == NULL) break;
+            mouse_move(m, event->motion.x, event->motion.y);
             break;
 
+        /*Finger coordinates are normalized to the window*/
         case SDL_FINGERUP:
-            left_button_down = false;
-            last_x = LV_HOR_RES * event->tfinger.x / SDL_ZOOM;
-            last_y = LV_VER_RES * event->tfinger.y / SDL_ZOOM;
-            break;
         case SDL_FINGERDOWN:
-            left_button_down = true;
-            last_x = LV_HOR_RES * event->tfinger.x / SDL_ZOOM;
-            last_y = LV_VER_RES * event->tfinger.y / SDL_ZOOM;
-            break;
         case SDL_FINGERMOTION:
-            last_x = LV_HOR_RES * event->tfinger.x / SDL_ZOOM;
-            last_y = LV_VER_RES * event->tfinger.y / SDL_ZOOM;
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+            m = monitor_from_id(event->tfinger.windowID);
+#else
+            m = NULL;
+#endif
+            if(m == NULL) m = monitor_list;
+            if(m == NULL) break;
+            if(event->type != SDL_FINGERMOTION) m->left_button_down = event->type == SDL_FINGERDOWN;
+            m->last_x = m->hor_res * event->tfinger.x;
+            m->last_y = m->ver_res * event->tfinger.y;
             break;
     }
 
 }
 
+/**
+ * Store the pointer position in display coordinates
+ * @param m the window of the pointer
+ * @param x horizontal position in the window
+ * @param y vertical position in the window
+ */
+static void mouse_move(monitor_t * m, int x, int y)
+{
+    int w;
+    int h;
+
+    /*The display is stretched to the whole window, after `sdl_display_resize()` or a
+     *resized window the initial zoom no longer relates the two*/
+    SDL_GetWindowSize(m->window, &w, &h);
+    if(w <= 0 || h <= 0) return;
+
+    m->last_x = (int32_t)x * m->hor_res / w;
+    m->last_y = (int32_t)y * m->ver_res / h;
+}
+
 
 /**
  * It is called periodically from the SDL thread to check mouse wheel state
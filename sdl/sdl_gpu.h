@@ -36,6 +36,8 @@ extern "C" {
 /**********************
  *      TYPEDEFS
  **********************/
+/*Context of an accelerated window with its own renderer and texture*/
+typedef struct _sdl_window_t sdl_window_t;
 
 /**********************
  * GLOBAL PROTOTYPES
@@ -46,6 +48,38 @@ extern "C" {
  */
 void sdl_init(void);
 
+/**
+ * Open an accelerated window. Any number of windows can be created at runtime.
+ * Initialize the display with `sdl_gpu_window_draw_buf_init()` and `sdl_gpu_window_drv_init()`.
+ * `sdl_init()` doesn't need to be called if only this function is used to create windows.
+ * @param hor_res horizontal resolution of the simulated display
+ * @param ver_res vertical resolution of the simulated display
+ * @param zoom scale the window by this factor
+ * @return the window's context or NULL on error
+ */
+sdl_window_t * sdl_window_create(lv_coord_t hor_res, lv_coord_t ver_res, int zoom);
+
+/**
+ * Close a window created by `sdl_window_create()`.
+ * @param win the window's context
+ */
+void sdl_window_delete(sdl_window_t * win);
+
+/**
+ * Initialize a draw buffer with the texture of a window
+ * @param win the window's context
+ * @param draw_buf the draw buffer to initialize
+ */
+void sdl_gpu_window_draw_buf_init(sdl_window_t * win, lv_disp_draw_buf_t * draw_buf);
+
+/**
+ * Initialize a display driver to render with the renderer of a window.
+ * `user_data` will point to the window's renderer, as LVGL's SDL renderer requires.
+ * @param win the window's context
+ * @param driver the display driver to initialize
+ */
+void sdl_gpu_window_drv_init(sdl_window_t * win, lv_disp_drv_t * driver);
+
 /**
  * IMPORTANT: Initialize draw buffer with one `SDL_Texture`.
  * Use this instead of `lv_disp_draw_buf_init` because `buf1` isn't a real
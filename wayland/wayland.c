@@ -54,6 +54,30 @@
 #define LV_WAYLAND_CYCLE_PERIOD LV_MIN(LV_DISP_DEF_REFR_PERIOD,1)
 #endif
 
+#ifndef LV_WAYLAND_BUFFER_COUNT
+#define LV_WAYLAND_BUFFER_COUNT 2
+#endif
+
+#if LV_WAYLAND_BUFFER_COUNT < 2
+#error "LV_WAYLAND_BUFFER_COUNT must be at least 2"
+#endif
+
+#ifndef LV_WAYLAND_DIRECT_MODE
+#define LV_WAYLAND_DIRECT_MODE 0
+#endif
+
+#if LV_WAYLAND_DIRECT_MODE
+#if (LV_WAYLAND_BUFFER_COUNT != 2)
+#error "LV_WAYLAND_DIRECT_MODE requires LV_WAYLAND_BUFFER_COUNT to be 2"
+#endif
+#if (LV_COLOR_DEPTH == 1)
+#error "LV_WAYLAND_DIRECT_MODE is not supported with LV_COLOR_DEPTH 1"
+#endif
+#endif
+
+/* Areas tracked per damage list before they are merged into their bounding box */
+#define DAMAGE_AREAS_MAX 16
+
 /**********************
  *      TYPEDEFS
  **********************/
@@ -116,12 +140,21 @@ struct seat
     } xkb;
 };
 
+struct damage
+{
+    lv_area_t areas[DAMAGE_AREAS_MAX];
+    int count;
+};
+
 struct buffer_hdl
 {
     void *base;
     int size;
     struct wl_buffer *wl_buffer;
     bool busy;
+
+    // Areas drawn into other buffers since this one was last drawn
+    struct damage stale;
 };
 
 struct buffer_allocator
@@ -225,6 +258,19 @@ struct window
 
     struct graphic_object * body;
 
+    // Window body buffers; never drawn while held by the compositor
+    struct buffer_hdl buffers[LV_WAYLAND_BUFFER_COUNT];
+    struct buffer_hdl *front;   // last committed buffer
+    struct buffer_hdl *back;    // buffer drawn in the current frame
+
+    // Areas dropped since no buffer was free, redrawn once one is released
+    struct damage deferred;
+
+#if LV_WAYLAND_DIRECT_MODE
+    // LVGL's next draw buffer is held by the compositor, rendering waits for its release
+    bool render_paused;
+#endif
+
 #if LV_WAYLAND_CLIENT_SIDE_DECORATIONS
     struct graphic_object * decoration[NUM_DECORATIONS];
 #endif
@@ -1051,6 +1097,17 @@ static const struct wl_seat_listener seat_listener = {
     .capabilities = seat_handle_capabilities,
 };
 
+#if LV_WAYLAND_DIRECT_MODE
+static void hold_rendering(struct window *window)
+{
+    if ((window->lv_disp != NULL) && !window->render_paused)
+    {
+        window->render_paused = true;
+        lv_timer_pause(_lv_disp_get_refr_timer(window->lv_disp));
+    }
+}
+#endif
+
 #if LV_WAYLAND_WL_SHELL
 static void wl_shell_handle_ping(void *data, struct wl_shell_surface *shell_surface, uint32_t serial)
 {
@@ -1071,6 +1128,10 @@ static void wl_shell_handle_configure(void *data, struct wl_shell_surface *shell
         window->resize_width = width;
         window->resize_height = height;
         window->resize_pending = true;
+#if LV_WAYLAND_DIRECT_MODE
+        // The buffers LVGL draws into are about to be replaced
+        hold_rendering(window);
+#endif
     }
 }
 
@@ -1113,6 +1174,10 @@ static void xdg_toplevel_handle_configure(void *data, struct xdg_toplevel *xdg_t
         window->resize_width = width;
         window->resize_height = height;
         window->resize_pending = true;
+#if LV_WAYLAND_DIRECT_MODE
+        // The buffers LVGL draws into are about to be replaced
+        hold_rendering(window);
+#endif
     }
 }
 
@@ -1196,6 +1261,34 @@ static const struct wl_buffer_listener wl_buffer_listener = {
     .release = handle_wl_buffer_release,
 };
 
+static void damage_add(struct damage *damage, const lv_area_t *area)
+{
+    int i;
+
+    for (i = 0; i < damage->count; i++)
+    {
+        if (_lv_area_is_in(area, &damage->areas[i], 0))
+        {
+            return;
+        }
+    }
+
+    if (damage->count < DAMAGE_AREAS_MAX)
+    {
+        lv_area_copy(&damage->areas[damage->count], area);
+        damage->count++;
+        return;
+    }
+
+    // Out of slots, merge everything into the bounding box
+    for (i = 1; i < damage->count; i++)
+    {
+        _lv_area_join(&damage->areas[0], &damage->areas[0], &damage->areas[i]);
+    }
+    _lv_area_join(&damage->areas[0], &damage->areas[0], area);
+    damage->count = 1;
+}
+
 static bool initialize_allocator(struct buffer_allocator *allocator, const char *dir)
 {
     static const char template[] = "/lvgl-wayland-XXXXXX";
@@ -1326,6 +1419,8 @@ static bool initialize_buffer(struct window *window, struct buffer_hdl *buffer_h
     allocator->shm_file_free_size = LV_MAX(0, (allocator->shm_file_free_size - buffer_hdl->size));
 
     lv_memset_00(buffer_hdl->base, buffer_hdl->size);
+    buffer_hdl->busy = false;
+    buffer_hdl->stale.count = 0;
 
     return true;
 
@@ -1633,27 +1728,117 @@ static void detach_decoration(struct window *window,
 }
 #endif
 
+static int count_busy_buffers(struct window *window)
+{
+    int busy = 0;
+    int i;
+
+    for (i = 0; i < LV_WAYLAND_BUFFER_COUNT; i++)
+    {
+        if (window->buffers[i].busy)
+        {
+            busy++;
+        }
+    }
+
+    return busy;
+}
+
+static void sync_buffer(struct window *window, struct buffer_hdl *buffer,
+                        const struct buffer_hdl *src)
+{
+    const int stride = window->width * BYTES_PER_PIXEL;
+    int i;
+
+    // Bring the buffer up to date with the source buffer
+    for (i = 0; i < buffer->stale.count; i++)
+    {
+        const lv_area_t *area = &buffer->stale.areas[i];
+        const int offset = (area->y1 * stride) + (area->x1 * BYTES_PER_PIXEL);
+        const int len = lv_area_get_width(area) * BYTES_PER_PIXEL;
+        int y;
+
+        for (y = 0; y < lv_area_get_height(area); y++)
+        {
+            lv_memcpy((uint8_t *)buffer->base + offset + (y * stride),
+                      (const uint8_t *)src->base + offset + (y * stride),
+                      len);
+        }
+    }
+    buffer->stale.count = 0;
+}
+
+#if !LV_WAYLAND_DIRECT_MODE
+static struct buffer_hdl * acquire_buffer(struct window *window)
+{
+    struct buffer_hdl *buffer = NULL;
+    int i;
+
+    // Prefer the released buffer that needs the least copying
+    for (i = 0; i < LV_WAYLAND_BUFFER_COUNT; i++)
+    {
+        if (!window->buffers[i].busy &&
+            ((buffer == NULL) || (window->buffers[i].stale.count < buffer->stale.count)))
+        {
+            buffer = &window->buffers[i];
+        }
+    }
+
+    if ((buffer != NULL) && (window->front != NULL) && (buffer != window->front))
+    {
+        sync_buffer(window, buffer, window->front);
+    }
+
+    return buffer;
+}
+#endif
+
+#if LV_WAYLAND_DIRECT_MODE
+static void resume_rendering(struct window *window)
+{
+    struct buffer_hdl *next = (window->front == &window->buffers[0]) ?
+                              &window->buffers[1] : &window->buffers[0];
+
+    // LVGL draws into the buffer not committed last, sync it once it's released
+    if (!window->render_paused || next->busy)
+    {
+        return;
+    }
+
+    sync_buffer(window, next, window->front);
+    window->render_paused = false;
+    lv_timer_resume(_lv_disp_get_refr_timer(window->lv_disp));
+}
+#endif
+
 static bool resize_window(struct window *window, int width, int height)
 {
-    struct buffer_hdl *buffer = &window->body->buffer;
+    int i;
 
     LV_LOG_TRACE("resize window %dx%d", width, height);
 
     // De-initialize previous buffers
-    if (buffer->busy)
+    if (count_busy_buffers(window) > 0)
     {
         LV_LOG_WARN("Deinitializing busy window buffer...");
         wl_surface_attach(window->body->surface, NULL, 0, 0);
         wl_surface_commit(window->body->surface);
-        buffer->busy = false;
     }
 
-    if (!deinitialize_buffer(window, buffer))
+    for (i = 0; i < LV_WAYLAND_BUFFER_COUNT; i++)
     {
-        LV_LOG_ERROR("failed to deinitialize window buffer");
-        return false;
+        if (!deinitialize_buffer(window, &window->buffers[i]))
+        {
+            LV_LOG_ERROR("failed to deinitialize window buffer");
+            return false;
+        }
+        window->buffers[i].busy = false;
     }
 
+    window->front = NULL;
+    window->back = NULL;
+    window->deferred.count = 0;
+
 #if LV_WAYLAND_CLIENT_SIDE_DECORATIONS
     int b;
     for (b = 0; b < NUM_DECORATIONS; b++)
@@ -1666,11 +1851,14 @@ static bool resize_window(struct window *window, int width, int height)
     }
 #endif
 
-    // Initialize backing buffer
-    if (!initialize_buffer(window, buffer, width, height))
+    // Initialize backing buffers
+    for (i = 0; i < LV_WAYLAND_BUFFER_COUNT; i++)
     {
-        LV_LOG_ERROR("failed to initialize window buffer");
-        return false;
+        if (!initialize_buffer(window, &window->buffers[i], width, height))
+        {
+            LV_LOG_ERROR("failed to initialize window buffer");
+            return false;
+        }
     }
 
     window->width = width;
@@ -1700,6 +1888,17 @@ static bool resize_window(struct window *window, int width, int height)
     if (window->lv_disp != NULL)
     {
         // Propagate resize to upper layers
+#if LV_WAYLAND_DIRECT_MODE
+        lv_disp_draw_buf_init(&window->lv_disp_draw_buf,
+                              window->buffers[0].base, window->buffers[1].base,
+                              width * height);
+        if (window->render_paused)
+        {
+            // The new buffers are not held by the compositor
+            window->render_paused = false;
+            lv_timer_resume(_lv_disp_get_refr_timer(window->lv_disp));
+        }
+#endif
         window->lv_disp_drv.hor_res = width;
         window->lv_disp_drv.ver_res = height;
         lv_disp_drv_update(window->lv_disp, &window->lv_disp_drv);
@@ -1882,16 +2081,67 @@ static void destroy_window(struct window *window)
     }
 #endif
 
-    deinitialize_buffer(window, &window->body->buffer);
+#if LV_WAYLAND_DIRECT_MODE
+    // The display draws straight into the buffers, stop refreshing before they are unmapped
+    hold_rendering(window);
+#endif
+
+    int i;
+    for (i = 0; i < LV_WAYLAND_BUFFER_COUNT; i++)
+    {
+        deinitialize_buffer(window, &window->buffers[i]);
+    }
     destroy_graphic_obj(window->body);
 
     deinitialize_allocator(&window->allocator);
 }
 
+#if LV_WAYLAND_DIRECT_MODE
+static struct buffer_hdl *rendered_buffer(struct window *window)
+{
+    // LVGL has already rendered into the SHM buffer, find which one
+    return (window->lv_disp_drv.draw_buf->buf_act == window->buffers[0].base) ?
+           &window->buffers[0] : &window->buffers[1];
+}
+#endif
+
+static void commit_buffer(struct window *window, struct buffer_hdl *buffer)
+{
+    wl_surface_attach(window->body->surface, buffer->wl_buffer, 0, 0);
+    wl_surface_commit(window->body->surface);
+    buffer->busy = true;
+    window->front = buffer;
+    window->back = NULL;
+    window->flush_pending = true;
+
+#if LV_WAYLAND_DIRECT_MODE
+    // LVGL renders the next frame into the other buffer: hold rendering until it's released
+    hold_rendering(window);
+    resume_rendering(window);
+#endif
+}
+
+static void skip_flush(struct window *window, lv_disp_drv_t *disp_drv)
+{
+#if LV_WAYLAND_DIRECT_MODE
+    // LVGL moves on to the other buffer after the last flush even if it is skipped,
+    // unless a resize is about to replace both
+    if (lv_disp_flush_is_last(disp_drv) && !window->resize_pending)
+    {
+        commit_buffer(window, rendered_buffer(window));
+    }
+#else
+    LV_UNUSED(window);
+#endif
+    lv_disp_flush_ready(disp_drv);
+}
+
 static void _lv_wayland_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p)
 {
     struct window *window = disp_drv->user_data;
-    struct buffer_hdl *buffer = &window->body->buffer;
+    struct buffer_hdl *buffer;
+    lv_area_t clipped;
+    int i;
 
     const lv_coord_t hres = (disp_drv->rotated == 0) ? (disp_drv->hor_res) : (disp_drv->ver_res);
     const lv_coord_t vres = (disp_drv->rotated == 0) ? (disp_drv->ver_res) : (disp_drv->hor_res);
@@ -1902,61 +2152,113 @@ static void _lv_wayland_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv
         LV_LOG_ERROR("please intialize wayland display using lv_wayland_create_window()");
         return;
     }
-    /* If window has been / is being closed, or is not visible, skip rendering */
-    else if (window->closed || window->shall_close)
+    /* If window has been closed, its buffers are gone */
+    else if (window->closed)
     {
         lv_disp_flush_ready(disp_drv);
         return;
     }
+#if !LV_WAYLAND_DIRECT_MODE
+    /* If window is being closed, skip rendering */
+    else if (window->shall_close)
+    {
+        lv_disp_flush_ready(disp_drv);
+        return;
+    }
+#endif
     /* Return if the area is out the screen */
     else if ((area->x2 < 0) || (area->y2 < 0) || (area->x1 > hres - 1) || (area->y1 > vres - 1))
     {
-        lv_disp_flush_ready(disp_drv);
+        skip_flush(window, disp_drv);
         return;
     }
     else if (window->resize_pending)
     {
         LV_LOG_TRACE("skip flush since resize is pending");
+        skip_flush(window, disp_drv);
+        return;
+    }
+
+    lv_area_set(&clipped, 0, 0, (disp_drv->hor_res - 1), (disp_drv->ver_res - 1));
+    if (!_lv_area_intersect(&clipped, &clipped, area))
+    {
+        skip_flush(window, disp_drv);
+        return;
+    }
+
+#if LV_WAYLAND_DIRECT_MODE
+    buffer = rendered_buffer(window);
+    LV_UNUSED(color_p);
+#else
+    // Pick a buffer released by the compositor at the start of the frame
+    if (window->back == NULL)
+    {
+        window->back = acquire_buffer(window);
+    }
+
+    buffer = window->back;
+    if (buffer == NULL)
+    {
+        LV_LOG_TRACE("all buffers are busy, deferring area");
+        damage_add(&window->deferred, &clipped);
         lv_disp_flush_ready(disp_drv);
         return;
     }
 
-    int32_t x;
+    // Copy the visible part of the area row by row
+    const int32_t src_stride = lv_area_get_width(area);
+    const int32_t dst_stride = disp_drv->hor_res * BYTES_PER_PIXEL;
+    const int32_t width = lv_area_get_width(&clipped);
+    const lv_color_t *src = color_p + ((clipped.y1 - area->y1) * src_stride) + (clipped.x1 - area->x1);
+    uint8_t *dst = (uint8_t *)buffer->base + (clipped.y1 * dst_stride) + (clipped.x1 * BYTES_PER_PIXEL);
     int32_t y;
 
-    for (y = area->y1; y <= area->y2 && y < disp_drv->ver_res; y++)
+#if (LV_COLOR_DEPTH == 1)
+    int32_t x;
+
+    // The color channels share a single bit, expand it to white or black RGB332
+    for (y = clipped.y1; y <= clipped.y2; y++)
     {
-        for (x = area->x1; x <= area->x2 && x < disp_drv->hor_res; x++)
+        for (x = 0; x < width; x++)
         {
-            int offset = (y * disp_drv->hor_res) + x;
-#if (LV_COLOR_DEPTH == 32)
-            uint32_t * const buf = (uint32_t *)buffer->base + offset;
-            *buf = color_p->full;
-#elif (LV_COLOR_DEPTH == 16)
-            uint16_t * const buf = (uint16_t *)buffer->base + offset;
-            *buf = color_p->full;
-#elif (LV_COLOR_DEPTH == 8)
-            uint8_t * const buf = (uint8_t *)buffer->base + offset;
-            *buf = color_p->full;
-#elif (LV_COLOR_DEPTH == 1)
-            uint8_t * const buf = (uint8_t *)buffer->base + offset;
-            *buf = ((0x07 * color_p->ch.red)   << 5) |
-                   ((0x07 * color_p->ch.green) << 2) |
-                   ((0x03 * color_p->ch.blue)  << 0);
-#endif
-            color_p++;
+            dst[x] = (src[x].full & 0x01) ? 0xFF : 0x00;
         }
+        src += src_stride;
+        dst += dst_stride;
+    }
+#else
+    if ((width * BYTES_PER_PIXEL == dst_stride) && (src_stride == width))
+    {
+        // Full width rows are contiguous on both sides
+        lv_memcpy(dst, src, lv_area_get_height(&clipped) * dst_stride);
     }
+    else
+    {
+        for (y = clipped.y1; y <= clipped.y2; y++)
+        {
+            lv_memcpy(dst, src, width * BYTES_PER_PIXEL);
+            src += src_stride;
+            dst += dst_stride;
+        }
+    }
+#endif
+#endif /* LV_WAYLAND_DIRECT_MODE */
 
     wl_surface_damage(window->body->surface, area->x1, area->y1,
                       (area->x2 - area->x1 + 1), (area->y2 - area->y1 + 1));
 
+    // The other buffers have to catch up with this area before they are drawn
+    for (i = 0; i < LV_WAYLAND_BUFFER_COUNT; i++)
+    {
+        if (&window->buffers[i] != buffer)
+        {
+            damage_add(&window->buffers[i].stale, &clipped);
+        }
+    }
+
     if (lv_disp_flush_is_last(disp_drv))
     {
-        wl_surface_attach(window->body->surface, buffer->wl_buffer, 0, 0);
-        wl_surface_commit(window->body->surface);
-        buffer->busy = true;
-        window->flush_pending = true;
+        commit_buffer(window, buffer);
     }
 
     lv_disp_flush_ready(disp_drv);
@@ -2020,7 +2322,7 @@ static void _lv_wayland_cycle(lv_timer_t * tmr)
         }
         else if (window->resize_pending)
         {
-            bool do_resize = !window->body->buffer.busy;
+            bool do_resize = (count_busy_buffers(window) == 0);
 #if LV_WAYLAND_CLIENT_SIDE_DECORATIONS
             if (!window->application->opt_disable_decorations && !window->fullscreen)
             {
@@ -2045,6 +2347,22 @@ static void _lv_wayland_cycle(lv_timer_t * tmr)
         else
         {
             shall_flush |= window->flush_pending;
+
+#if LV_WAYLAND_DIRECT_MODE
+            resume_rendering(window);
+#endif
+
+            // Redraw the areas dropped while every buffer was busy
+            if ((window->deferred.count > 0) &&
+                (count_busy_buffers(window) < LV_WAYLAND_BUFFER_COUNT))
+            {
+                int i;
+                for (i = 0; i < window->deferred.count; i++)
+                {
+                    _lv_inv_area(window->lv_disp, &window->deferred.areas[i]);
+                }
+                window->deferred.count = 0;
+            }
         }
         window->flush_pending = false;
     }
@@ -2247,7 +2565,6 @@ void lv_wayland_deinit(void)
 lv_disp_t * lv_wayland_create_window(lv_coord_t hor_res, lv_coord_t ver_res, char *title,
                                      lv_wayland_display_close_f_t close_cb)
 {
-    lv_color_t * buf1 = NULL;
     struct window *window;
 
     window = create_window(&application, hor_res, ver_res, title);
@@ -2260,7 +2577,12 @@ lv_disp_t * lv_wayland_create_window(lv_coord_t hor_res, lv_coord_t ver_res, cha
     window->close_cb = close_cb;
 
     /* Initialize draw buffer */
-    buf1 = lv_mem_alloc(hor_res * ver_res * sizeof(lv_color_t));
+#if LV_WAYLAND_DIRECT_MODE
+    lv_disp_draw_buf_init(&window->lv_disp_draw_buf,
+                          window->buffers[0].base, window->buffers[1].base,
+                          hor_res * ver_res);
+#else
+    lv_color_t * buf1 = lv_mem_alloc(hor_res * ver_res * sizeof(lv_color_t));
     if (!buf1)
     {
         LV_LOG_ERROR("failed to allocate draw buffer");
@@ -2269,6 +2591,7 @@ lv_disp_t * lv_wayland_create_window(lv_coord_t hor_res, lv_coord_t ver_res, cha
     }
 
     lv_disp_draw_buf_init(&window->lv_disp_draw_buf, buf1, NULL, hor_res * ver_res);
+#endif
 
     /* Initialize display driver */
     lv_disp_drv_init(&window->lv_disp_drv);
@@ -2277,9 +2600,18 @@ lv_disp_t * lv_wayland_create_window(lv_coord_t hor_res, lv_coord_t ver_res, cha
     window->lv_disp_drv.ver_res = ver_res;
     window->lv_disp_drv.flush_cb = _lv_wayland_flush;
     window->lv_disp_drv.user_data = window;
+#if LV_WAYLAND_DIRECT_MODE
+    window->lv_disp_drv.direct_mode = 1;
+#endif
 
     /* Register display */
     window->lv_disp = lv_disp_drv_register(&window->lv_disp_drv);
+#if LV_WAYLAND_DIRECT_MODE
+    if (window->resize_pending)
+    {
+        hold_rendering(window);
+    }
+#endif
 
     /* Register input */
     lv_indev_drv_init(&window->lv_indev_drv_pointer);